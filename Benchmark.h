@@ -0,0 +1,47 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QTextStream>
+#include <QIODevice>
+#include <QVector>
+#include <QString>
+#include <algorithm>
+
+// Benchmarks write one long format CSV row per measurement, so runs of
+// different benchmarks and machines can be concatenated and compared:
+//
+//   benchmark,n,k,threads,phase,ms
+//
+// ms is the median wall time of the repeats of that phase.
+class BenchmarkWriter
+{
+public:
+  explicit BenchmarkWriter(QIODevice* device) : out_(device)
+  {
+    out_ << "benchmark,n,k,threads,phase,ms\n";
+    out_.flush();
+  };
+
+  void row(const QString& benchmark, qint64 n, int k, int threads,
+           const QString& phase, double ms)
+  {
+    out_ << benchmark << ',' << n << ',' << k << ',' << threads << ','
+         << phase << ',' << QString::number(ms, 'f', 3) << '\n';
+    out_.flush();
+  };
+
+private:
+  QTextStream out_;
+};
+
+inline double medianMs(QVector<double> samples)
+{
+  if (samples.isEmpty())
+    return 0.0;
+  std::sort(samples.begin(), samples.end());
+  const int half = samples.size() / 2;
+  return samples.size() % 2 ? samples[half]
+                            : 0.5 * (samples[half - 1] + samples[half]);
+}
+
+#endif // BENCHMARK_H
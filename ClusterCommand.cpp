@@ -0,0 +1,106 @@
+#include "ClusterCommand.h"
+#include "Coreset.h"
+#include "Deduplicate.h"
+#include "GridAggregate.h"
+#include "MainWindow.h"
+#include "Pair.h"
+#include "kmeans.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+namespace
+{
+template <class T>
+void cluster(DatasetPtr data, const ClusterCommand::Options& options,
+             QTextStream& out)
+{
+  kmeans<T> engine(options.k, data);
+  engine.setSeed(options.seed);
+  engine.setInitialization(InitializeType::Kpp);
+  engine.setStatsEnabled(true);
+  KMeansStats reduced;
+  engine.setStatsCallback([&reduced](const KMeansStats& stats)
+  {
+    if (stats.reducedPoints > 0)
+      reduced = stats;
+  });
+
+  QElapsedTimer timer;
+  timer.start();
+  if (options.coresetSize > 0)
+  {
+    Coreset::Options coreset;
+    coreset.size = options.coresetSize;
+    coreset.seed = options.seed;
+    engine.setReduction(Coreset::Build(*data, coreset), QVector<quint32>(),
+                        options.refine);
+  }
+  else if (options.grid)
+  {
+    GridAggregate::Result grid = GridAggregate::Build(*data,
+                                                      GridAggregate::Options());
+    engine.setReduction(grid.cells, grid.cellOf, options.refine);
+  }
+  engine.finish(T::EuclideanDistance);
+
+  qInfo() << "Rows:" << data->rowCount() << "points:" << data->size()
+          << "k:" << options.k;
+  if (reduced.reducedPoints > 0)
+    qInfo() << "Reduced to" << reduced.reducedPoints << "points, energy"
+            << reduced.reducedEnergy << "bound" << reduced.reductionBound;
+  qInfo() << "Iterations:" << engine.iteration() << "energy:"
+          << engine.getEnergy() << "-" << engine.stopReason;
+  qInfo() << "Time:" << timer.elapsed() << "ms";
+
+  for (quint32 assignment : engine.rowAssignments())
+    out << assignment << '\n';
+}
+}
+
+int ClusterCommand::run(const Options& options)
+{
+  QFile input(options.input);
+  if (!input.open(QIODevice::ReadOnly | QIODevice::Text))
+  {
+    qCritical() << "Could not read" << options.input;
+    return 1;
+  }
+  QTextStream in(&input);
+  in.readLine();
+  const int dimensions = in.readLine().toInt();
+  if (dimensions != 2 && dimensions != 3)
+  {
+    qCritical() << "Unsupported dimensions" << dimensions;
+    return 1;
+  }
+  DatasetPtr data = dimensions == 2 ? MainWindow::Parse2D(in)
+                                    : MainWindow::Parse3D(in);
+  if (options.dedup)
+    data = Deduplicate::Collapse(data);
+  if (data->size() == 0)
+  {
+    qCritical() << "No points in" << options.input;
+    return 1;
+  }
+
+  QFile file;
+  if (options.output.isEmpty())
+    file.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+  else
+  {
+    file.setFileName(options.output);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+      qCritical() << "Could not write" << options.output;
+      return 1;
+    }
+  }
+  QTextStream out(&file);
+  if (dimensions == 2)
+    cluster<Pair2D>(data, options, out);
+  else
+    cluster<Pair3D>(data, options, out);
+  return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef CLUSTERCOMMAND_H
+#define CLUSTERCOMMAND_H
+
+#include <QString>
+
+// Clusters a data file in the import format without the GUI, with k-means++
+// initialization and the Euclidean distance. Writes the cluster of every
+// row, one per line in file order, and a summary to the log.
+class ClusterCommand
+{
+public:
+  struct Options
+  {
+    QString input;
+    int k = 8;
+    quint64 seed = 1;
+    // Collapse exact duplicates before clustering
+    bool dedup = false;
+    // Cluster a coreset of this many points first, 0 for none
+    qint32 coresetSize = 0;
+    // Cluster grid cells first, see GridAggregate
+    bool grid = false;
+    // Continue with Lloyd steps on all points after a coreset or the grid
+    bool refine = false;
+    // Empty writes to stdout
+    QString output;
+  };
+
+  // Returns the process exit code
+  static int run(const Options& options);
+};
+
+#endif // CLUSTERCOMMAND_H
@@ -0,0 +1,140 @@
+#include "ClusterPlot2D.h"
+
+ClusterPlot2D::ClusterPlot2D(QCustomPlot* plot)
+{
+  plot_ = plot;
+  scatter_ = nullptr;
+  regions_ = nullptr;
+  regionsVisible_ = false;
+  metric_ = DecisionRegions::Euclidean;
+}
+
+void ClusterPlot2D::setDataset(const DatasetPtr& dataset)
+{
+  dataset_ = dataset;
+}
+
+void ClusterPlot2D::setColors(const QVector<QColor>& colors)
+{
+  colors_ = colors;
+  if (scatter_ != nullptr)
+    scatter_->setPalette(colors_);
+  if (regions_ != nullptr)
+    regions_->setPalette(colors_);
+  for (int i = 0; i < centroidGraphs_.size() && i < colors_.size(); i++)
+    centroidGraphs_[i]->setPen(QPen(colors_[i]));
+}
+
+void ClusterPlot2D::setStyles(const QCPScatterStyle& pointStyle,
+                              const QCPScatterStyle& centroidStyle)
+{
+  pointStyle_ = pointStyle;
+  centroidStyle_ = centroidStyle;
+  if (scatter_ != nullptr)
+    scatter_->setScatterStyle(pointStyle_);
+  for (QCPGraph* g : centroidGraphs_)
+    g->setScatterStyle(centroidStyle_);
+  plot_->replot(QCustomPlot::rpQueuedReplot);
+}
+
+void ClusterPlot2D::setRegionsVisible(bool visible)
+{
+  regionsVisible_ = visible;
+  if (regions_ != nullptr)
+  {
+    regions_->setVisible(regionsVisible_);
+    plot_->replot(QCustomPlot::rpQueuedReplot);
+  }
+}
+
+void ClusterPlot2D::setMetric(DecisionRegions::Metric metric)
+{
+  metric_ = metric;
+  if (regions_ != nullptr)
+    regions_->setMetric(metric_);
+}
+
+// The data set before clustering: points only, in the default graph color
+void ClusterPlot2D::showPoints()
+{
+  TRACE_SCOPE("ClusterPlot2D::showPoints", "gui");
+  createPlottables(0);
+  scatter_->setPen(QPen(Qt::blue, 0));
+  if (!dataset_.isNull())
+    scatter_->setData(dataset_->x(), dataset_->y(), QVector<quint32>());
+  plot_->replot(QCustomPlot::rpQueuedReplot);
+}
+
+void ClusterPlot2D::rebuild(const QVector<Pair2D>& centroids,
+                            const QVector<quint32>& assignments)
+{
+  TRACE_SCOPE("ClusterPlot2D::rebuild", "gui");
+  int k = centroids.size();
+  if (scatter_ == nullptr || centroidGraphs_.size() != k)
+    createPlottables(k);
+
+  scatter_->setData(dataset_->x(), dataset_->y(), assignments);
+  regions_->setCentroids(centroids);
+  for (int c = 0; c < k; c++)
+    setCentroid(c, centroids[c]);
+  plot_->replot(QCustomPlot::rpQueuedReplot);
+}
+
+// A step only moves the reassigned points and the centroids that changed, on
+// top of the clustering of the last rebuild() or update().
+void ClusterPlot2D::update(const QVector<Pair2D>& centroids,
+                           const KMeansDelta& delta)
+{
+  if (scatter_ == nullptr || centroidGraphs_.size() != centroids.size())
+    return;
+
+  TRACE_SCOPE("ClusterPlot2D::update", "gui");
+  scatter_->updateClusters(delta.changes);
+  if (!delta.movedCentroids.isEmpty())
+    regions_->setCentroids(centroids);
+  for (quint32 c : delta.movedCentroids)
+    setCentroid(c, centroids[c]);
+  plot_->replot(QCustomPlot::rpQueuedReplot);
+}
+
+void ClusterPlot2D::clear()
+{
+  if (scatter_ != nullptr)
+    plot_->removePlottable(scatter_);
+  if (regions_ != nullptr)
+    plot_->removePlottable(regions_);
+  plot_->clearGraphs();
+  scatter_ = nullptr;
+  regions_ = nullptr;
+  centroidGraphs_.clear();
+}
+
+void ClusterPlot2D::createPlottables(int k)
+{
+  clear();
+  // Created first so it is drawn beneath the points
+  regions_ = new DecisionRegions(plot_->xAxis, plot_->yAxis);
+  regions_->setPalette(colors_);
+  regions_->setMetric(metric_);
+  regions_->setVisible(regionsVisible_);
+
+  scatter_ = new ClusterScatter(plot_->xAxis, plot_->yAxis);
+  scatter_->setScatterStyle(pointStyle_);
+  scatter_->setPalette(colors_);
+
+  for (int i = 0; i < k; i++)
+  {
+    QCPGraph* g = plot_->addGraph();
+    g->setLineStyle(QCPGraph::lsNone);
+    g->setScatterStyle(centroidStyle_);
+    g->setPen(QPen(colors_.value(i)));
+    centroidGraphs_.append(g);
+  }
+}
+
+void ClusterPlot2D::setCentroid(int cluster, const Pair2D& centroid)
+{
+  QSharedPointer<QCPGraphDataContainer> data = centroidGraphs_[cluster]->data();
+  data->clear();
+  data->add(QCPGraphData(centroid[0], centroid[1]));
+}
@@ -0,0 +1,51 @@
+#ifndef CLUSTERPLOT2D_H
+#define CLUSTERPLOT2D_H
+
+#include <QVector>
+#include <QColor>
+#include <qcustomplot.h>
+#include <kmeans.h>
+#include <Pair.h>
+#include <Dataset.h>
+#include <ClusterScatter.h>
+#include <DecisionRegions.h>
+
+// Persistent 2D plot of a clustering. All points are drawn by one
+// ClusterScatter colored by cluster index; one centroid graph per cluster is
+// kept alive between steps and only moved centroids are updated. Replots are
+// queued, so several updates within one frame cost a single replot.
+// Optionally the nearest-centroid regions are shaded underneath the points.
+// The scatter reads the columns of the shared data set without copying them.
+class ClusterPlot2D
+{
+public:
+  explicit ClusterPlot2D(QCustomPlot* plot);
+
+  void setDataset(const DatasetPtr& dataset);
+  void setColors(const QVector<QColor>& colors);
+  void setStyles(const QCPScatterStyle& pointStyle,
+                 const QCPScatterStyle& centroidStyle);
+  void setRegionsVisible(bool visible);
+  void setMetric(DecisionRegions::Metric metric);
+  void showPoints();
+  void rebuild(const QVector<Pair2D>& centroids,
+               const QVector<quint32>& assignments);
+  void update(const QVector<Pair2D>& centroids, const KMeansDelta& delta);
+  void clear();
+
+private:
+  QCustomPlot* plot_;
+  DatasetPtr dataset_;
+  QVector<QColor> colors_;
+  QCPScatterStyle pointStyle_, centroidStyle_;
+  ClusterScatter* scatter_;
+  DecisionRegions* regions_;
+  bool regionsVisible_;
+  DecisionRegions::Metric metric_;
+  QVector<QCPGraph*> centroidGraphs_;
+
+  void createPlottables(int k);
+  void setCentroid(int cluster, const Pair2D& centroid);
+};
+
+#endif // CLUSTERPLOT2D_H
@@ -0,0 +1,184 @@
+#include "ClusterScatter.h"
+#include "Trace.h"
+
+ClusterScatter::ClusterScatter(QCPAxis* keyAxis, QCPAxis* valueAxis) :
+  QCPAbstractPlottable(keyAxis, valueAxis),
+  lodThreshold_(200000)
+{
+  setSelectable(QCP::stNone);
+}
+
+void ClusterScatter::setData(const QVector<double>& keys,
+                             const QVector<double>& values,
+                             const QVector<quint32>& clusters)
+{
+  keys_ = keys;
+  values_ = values;
+  clusters_ = clusters;
+  raster_.invalidate();
+}
+
+void ClusterScatter::setClusters(const QVector<quint32>& clusters)
+{
+  clusters_ = clusters;
+  raster_.invalidate();
+}
+
+// Moves the given points to their new clusters in place. Only the first
+// update after setClusters() copies, if the clusters are still shared.
+void ClusterScatter::updateClusters(const QVector<AssignmentChange>& changes)
+{
+  if (changes.isEmpty())
+    return;
+  quint32* clusters = clusters_.data();
+  for (const AssignmentChange& change : changes)
+    clusters[change.point] = change.to;
+  raster_.invalidate();
+}
+
+void ClusterScatter::setPalette(const QVector<QColor>& palette)
+{
+  palette_ = palette;
+}
+
+void ClusterScatter::setScatterStyle(const QCPScatterStyle& style)
+{
+  scatterStyle_ = style;
+}
+
+// A threshold of 0 always draws exact points
+void ClusterScatter::setLodThreshold(int points)
+{
+  lodThreshold_ = points;
+}
+
+int ClusterScatter::lodThreshold() const
+{
+  return lodThreshold_;
+}
+
+double ClusterScatter::selectTest(const QPointF& pos, bool onlySelectable,
+                                  QVariant* details) const
+{
+  Q_UNUSED(pos)
+  Q_UNUSED(onlySelectable)
+  Q_UNUSED(details)
+  return -1;
+}
+
+QCPRange ClusterScatter::getKeyRange(bool& foundRange,
+                                     QCP::SignDomain inSignDomain) const
+{
+  return columnRange(keys_, foundRange, inSignDomain);
+}
+
+QCPRange ClusterScatter::getValueRange(bool& foundRange,
+                                       QCP::SignDomain inSignDomain,
+                                       const QCPRange& inKeyRange) const
+{
+  Q_UNUSED(inKeyRange)
+  return columnRange(values_, foundRange, inSignDomain);
+}
+
+void ClusterScatter::draw(QCPPainter* painter)
+{
+  TRACE_SCOPE("ClusterScatter::draw", "gui");
+  QCPAxis* keyAxis = mKeyAxis.data();
+  QCPAxis* valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis || scatterStyle_.isNone())
+    return;
+  if (drawRaster(painter))
+    return;
+
+  // The last batch holds points without a valid cluster, drawn with pen()
+  batches_.resize(palette_.size() + 1);
+  for (QVector<QPointF>& batch : batches_)
+    batch.clear();
+
+  const QCPRange keyRange = keyAxis->range();
+  const QCPRange valueRange = valueAxis->range();
+  // Read through const pointers, a non-const index would detach the columns
+  // from the shared data set
+  const double* keys = keys_.constData();
+  const double* values = values_.constData();
+  const quint32* clusters = clusters_.constData();
+  const int n = qMin(keys_.size(), values_.size());
+  const int other = palette_.size();
+  for (int i = 0; i < n; i++)
+  {
+    if (!keyRange.contains(keys[i]) || !valueRange.contains(values[i]))
+      continue;
+    int c = i < clusters_.size() && int(clusters[i]) < other ?
+            int(clusters[i]) : other;
+    batches_[c].append(coordsToPixels(keys[i], values[i]));
+  }
+
+  applyScattersAntialiasingHint(painter);
+  for (int c = 0; c < batches_.size(); c++)
+  {
+    if (batches_[c].isEmpty())
+      continue;
+    scatterStyle_.applyTo(painter, c < other ? QPen(palette_[c]) : mPen);
+    for (const QPointF& point : batches_[c])
+      scatterStyle_.drawShape(painter, point);
+  }
+}
+
+bool ClusterScatter::drawRaster(QCPPainter* painter)
+{
+  QCPAxis* keyAxis = mKeyAxis.data();
+  QCPAxis* valueAxis = mValueAxis.data();
+  if (lodThreshold_ <= 0 || keys_.size() <= lodThreshold_ ||
+      keyAxis->orientation() != Qt::Horizontal)
+    return false;
+
+  const QCPRange keyRange = keyAxis->range();
+  const QCPRange valueRange = valueAxis->range();
+  if (raster_.countInRange(keys_, values_, clusters_, keyRange, valueRange) <=
+      lodThreshold_)
+    return false;
+
+  QRectF target = QRectF(coordsToPixels(keyRange.lower, valueRange.upper),
+                         coordsToPixels(keyRange.upper, valueRange.lower))
+                  .normalized();
+  QImage image = raster_.render(keys_, values_, clusters_, palette_, keyRange,
+                                valueRange, target.size().toSize());
+  if (image.isNull())
+    return true;
+  if (keyAxis->rangeReversed() || valueAxis->rangeReversed())
+    image = image.mirrored(keyAxis->rangeReversed(),
+                           valueAxis->rangeReversed());
+  painter->drawImage(target, image);
+  return true;
+}
+
+void ClusterScatter::drawLegendIcon(QCPPainter* painter,
+                                    const QRectF& rect) const
+{
+  applyScattersAntialiasingHint(painter);
+  scatterStyle_.applyTo(painter, palette_.isEmpty() ? mPen
+                                                    : QPen(palette_.first()));
+  scatterStyle_.drawShape(painter, rect.center());
+}
+
+QCPRange ClusterScatter::columnRange(const QVector<double>& column,
+                                     bool& foundRange,
+                                     QCP::SignDomain inSignDomain)
+{
+  QCPRange range;
+  foundRange = false;
+  for (double v : column)
+  {
+    if (qIsNaN(v) || (inSignDomain == QCP::sdNegative && v >= 0) ||
+        (inSignDomain == QCP::sdPositive && v <= 0))
+      continue;
+    if (!foundRange)
+    {
+      range.lower = range.upper = v;
+      foundRange = true;
+    }
+    else
+      range.expand(v);
+  }
+  return range;
+}
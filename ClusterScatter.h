@@ -0,0 +1,64 @@
+#ifndef CLUSTERSCATTER_H
+#define CLUSTERSCATTER_H
+
+#include <QVector>
+#include <QColor>
+#include <qcustomplot.h>
+#include "DensityRaster.h"
+#include "kmeans.h"
+
+// QCustomPlot plottable that draws every point of a clustering in one pass.
+// Points are given as key/value columns plus a cluster index per point and
+// colored from a palette. Drawing culls points outside the axis ranges and
+// batches the rest by cluster, so the pen is only switched once per color.
+// The columns are implicitly shared with the caller, never copied.
+//
+// When more points than the level of detail threshold are visible the plot
+// is drawn as a density image instead (see DensityRaster) and switches back
+// to exact points once zoomed in far enough.
+class ClusterScatter : public QCPAbstractPlottable
+{
+public:
+  ClusterScatter(QCPAxis* keyAxis, QCPAxis* valueAxis);
+
+  void setData(const QVector<double>& keys, const QVector<double>& values,
+               const QVector<quint32>& clusters);
+  void setClusters(const QVector<quint32>& clusters);
+  void updateClusters(const QVector<AssignmentChange>& changes);
+  void setPalette(const QVector<QColor>& palette);
+  void setScatterStyle(const QCPScatterStyle& style);
+  void setLodThreshold(int points);
+  int lodThreshold() const;
+
+  virtual double selectTest(const QPointF& pos, bool onlySelectable,
+                            QVariant* details = nullptr) const override;
+  virtual QCPRange getKeyRange(bool& foundRange,
+                               QCP::SignDomain inSignDomain = QCP::sdBoth)
+                               const override;
+  virtual QCPRange getValueRange(bool& foundRange,
+                                 QCP::SignDomain inSignDomain = QCP::sdBoth,
+                                 const QCPRange& inKeyRange = QCPRange())
+                                 const override;
+
+protected:
+  virtual void draw(QCPPainter* painter) override;
+  virtual void drawLegendIcon(QCPPainter* painter,
+                              const QRectF& rect) const override;
+
+private:
+  QVector<double> keys_;
+  QVector<double> values_;
+  QVector<quint32> clusters_;
+  QVector<QColor> palette_;
+  QCPScatterStyle scatterStyle_;
+  QVector<QVector<QPointF>> batches_;
+  int lodThreshold_;
+  DensityRaster raster_;
+
+  bool drawRaster(QCPPainter* painter);
+
+  static QCPRange columnRange(const QVector<double>& column, bool& foundRange,
+                              QCP::SignDomain inSignDomain);
+};
+
+#endif // CLUSTERSCATTER_H
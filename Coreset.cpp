@@ -0,0 +1,156 @@
+#include "Coreset.h"
+#include "Parallel.h"
+#include "Philox.h"
+#include "RandomData.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+const qint64 BlockSize = 1 << 16;
+const qint64 DrawGrain = 1 << 14;
+
+struct BlockTotals
+{
+  double weight = 0.0;
+  double distance = 0.0;
+};
+}
+
+DatasetPtr Coreset::Build(const Dataset& data, const Options& options)
+{
+  TRACE_SCOPE("coreset", "reduce");
+  const int dims = data.dimensions();
+  const qint32 n = data.size();
+  const qint32 m = qMax(0, options.size);
+  const double* const* columns = data.columnData();
+  const double* w = data.weights();
+  double mean[3] = {0.0, 0.0, 0.0};
+  for (int d = 0; d < dims; d++)
+    mean[d] = data.stats(d).mean;
+  // Not squared, like the energy (see Coreset.h)
+  auto distance = [&](qint64 i)
+  {
+    double sum = 0.0;
+    for (int d = 0; d < dims; d++)
+      sum += (columns[d][i] - mean[d]) * (columns[d][i] - mean[d]);
+    return std::sqrt(sum);
+  };
+
+  // First pass: weight and weighted distance to the mean of every block
+  const int blocks = int((n + BlockSize - 1) / BlockSize);
+  QVector<BlockTotals> totals(blocks);
+  BlockTotals* total = totals.data();
+  parallelFor(blocks, 1, [&](qint64 first, qint64 last)
+  {
+    for (qint64 b = first; b < last; b++)
+    {
+      BlockTotals block;
+      const qint64 end = qMin<qint64>(n, (b + 1) * BlockSize);
+      for (qint64 i = b * BlockSize; i < end; i++)
+      {
+        const double pw = w ? w[i] : 1.0;
+        block.weight += pw;
+        block.distance += pw * distance(i);
+      }
+      total[b] = block;
+    }
+  });
+  double weightSum = 0.0, distanceSum = 0.0;
+  for (const BlockTotals& block : totals)
+  {
+    weightSum += block.weight;
+    distanceSum += block.distance;
+  }
+  if (m == 0 || !(weightSum > 0.0))
+    return DatasetPtr(new Dataset(QVector<double>(), QVector<double>()));
+
+  // A point's share of the draws, the shares add up to 2. With every point
+  // on the mean only the weight counts.
+  const double weightScale = distanceSum > 0.0 ? 1.0 / weightSum
+                                               : 2.0 / weightSum;
+  const double distanceScale = distanceSum > 0.0 ? 1.0 / distanceSum : 0.0;
+  auto share = [&](qint64 i)
+  {
+    const double pw = w ? w[i] : 1.0;
+    return pw * weightScale + pw * distance(i) * distanceScale;
+  };
+
+  // Sorted draws in [0, 2), and the first draw and share before each block
+  QVector<double> draws(m);
+  double* draw = draws.data();
+  const quint64 seed = options.seed;
+  parallelFor(m, DrawGrain, [draw, seed](qint64 begin, qint64 end)
+  {
+    for (qint64 j = begin; j < end; j++)
+      draw[j] = 2.0 * PhiloxDraws(seed, RandomData::CoresetStream,
+                                  quint64(j)).uniform();
+  });
+  std::sort(draws.begin(), draws.end());
+  QVector<qint32> firstDraw(blocks + 1);
+  QVector<double> shareBefore(blocks);
+  double cumulative = 0.0;
+  for (int b = 0; b < blocks; b++)
+  {
+    firstDraw[b] = qint32(std::lower_bound(draws.constBegin(),
+                                           draws.constEnd(), cumulative) -
+                          draws.constBegin());
+    shareBefore[b] = cumulative;
+    cumulative += total[b].weight * weightScale +
+                  total[b].distance * distanceScale;
+  }
+  firstDraw[blocks] = m;
+
+  // Second pass over the blocks with draws. Draws past the last point's
+  // running share, from rounding, go to the block's last point with a share.
+  QVector<qint32> picks(m);
+  qint32* pick = picks.data();
+  const qint32* drawsFrom = firstDraw.constData();
+  const double* before = shareBefore.constData();
+  parallelFor(blocks, 1, [&](qint64 first, qint64 last)
+  {
+    for (qint64 b = first; b < last; b++)
+    {
+      qint32 j = drawsFrom[b];
+      const qint32 drawsEnd = drawsFrom[b + 1];
+      if (j == drawsEnd)
+        continue;
+      double position = before[b];
+      qint64 lastShared = b * BlockSize;
+      const qint64 end = qMin<qint64>(n, (b + 1) * BlockSize);
+      for (qint64 i = b * BlockSize; i < end && j < drawsEnd; i++)
+      {
+        const double s = share(i);
+        if (!(s > 0.0))
+          continue;
+        lastShared = i;
+        position += s;
+        while (j < drawsEnd && draw[j] < position)
+          pick[j++] = qint32(i);
+      }
+      while (j < drawsEnd)
+        pick[j++] = qint32(lastShared);
+    }
+  });
+
+  // Points drawn more than once become one point with the summed weight.
+  // Picks are sorted since the draws are.
+  QVector<double> coreset[3], weights;
+  for (qint32 j = 0; j < m; j++)
+  {
+    const qint32 i = pick[j];
+    const double pw = w ? w[i] : 1.0;
+    const double weight = 2.0 * pw / (double(m) * share(i));
+    if (j > 0 && pick[j - 1] == i)
+    {
+      weights.last() += weight;
+      continue;
+    }
+    for (int d = 0; d < dims; d++)
+      coreset[d].append(columns[d][i]);
+    weights.append(weight);
+  }
+  return DatasetPtr(new Dataset(std::move(coreset[0]), std::move(coreset[1]),
+                                std::move(coreset[2]), std::move(weights)));
+}
@@ -0,0 +1,33 @@
+#ifndef CORESET_H
+#define CORESET_H
+
+#include "Dataset.h"
+
+// Importance sampled coresets after the lightweight coresets of Bachem et
+// al., "Scalable k-Means Clustering via Lightweight Coresets". size points
+// are drawn with replacement, half uniformly by weight and half by weighted
+// distance to the mean, and each is weighted by its weight over size times
+// its probability. The energy of any centroids on the coreset is then an
+// unbiased estimate of their energy on the data set, so the coreset can
+// stand in for the data (kmeans<T>::setReduction()).
+//
+// The paper samples by squared distance for the squared error. This engine's
+// energy is the sum of plain distances, so the distance to the mean is used
+// as it is, and the paper's bound on the size for a given error does not
+// carry over. Check the energy of a reduced run against the data.
+//
+// Two parallel passes over blocks of points, the second only over blocks
+// that drew a point. A seed gives the same coreset for any number of threads.
+class Coreset
+{
+public:
+  struct Options
+  {
+    qint32 size = 10000;
+    quint64 seed = 1;
+  };
+
+  static DatasetPtr Build(const Dataset& data, const Options& options);
+};
+
+#endif // CORESET_H
@@ -0,0 +1,172 @@
+#include "Dataset.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const qint64 StatsChunk = 1 << 16;
+const qint64 PlaceChunk = 1 << 16;
+
+// Sums are taken relative to a shift value from the column, which keeps the
+// variance accurate for data far away from zero
+struct PartialStats
+{
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+  double sum = 0.0;
+  double sumSquares = 0.0;
+  qint64 count = 0;
+  qint64 nanCount = 0;
+};
+
+// A zero column whose pages are given back to the kernel, so the first write
+// to each page puts it on the memory node of the writing thread
+QVector<double> untouchedColumn(qint32 n)
+{
+  QVector<double> column(n);
+#ifdef Q_OS_LINUX
+  const quintptr page = quintptr(sysconf(_SC_PAGESIZE));
+  const quintptr begin = (quintptr(column.data()) + page - 1) & ~(page - 1);
+  const quintptr end = quintptr(column.data() + n) & ~(page - 1);
+  if (end > begin)
+    madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+#endif
+  return column;
+}
+}
+
+Dataset::Dataset(QVector<double> x, QVector<double> y, QVector<double> z,
+                 QVector<double> weights, QVector<quint32> rowIndex)
+{
+  dimensions_ = z.isEmpty() ? 2 : 3;
+  size_ = qMin(x.size(), y.size());
+  if (dimensions_ == 3)
+    size_ = qMin(size_, z.size());
+
+  columns_[0] = std::move(x);
+  columns_[1] = std::move(y);
+  columns_[2] = std::move(z);
+  weights_ = std::move(weights);
+  rowIndex_ = std::move(rowIndex);
+  if (!weights_.isEmpty())
+    weights_.resize(size_);
+  if (ThreadPool::instance().numaAware())
+    placeColumns();
+  for (int d = 0; d < 3; d++)
+    data_[d] = d < dimensions_ ? columns_[d].constData() : nullptr;
+  computeStats();
+
+  totalWeight_ = size_;
+  if (!weights_.isEmpty())
+  {
+    const double* w = weights_.constData();
+    totalWeight_ = parallelReduce(size_, StatsChunk, 0.0,
+                                  [w](qint64 begin, qint64 end)
+    {
+      double sum = 0.0;
+      for (qint64 i = begin; i < end; i++)
+        sum += w[i];
+      return sum;
+    }, [](double a, double b) { return a + b; });
+  }
+}
+
+// Copies every column into fresh pages, each range written by the worker
+// that parallelHome() loops over the points give it later
+void Dataset::placeColumns()
+{
+  QVector<QVector<double>*> columns;
+  for (int d = 0; d < dimensions_; d++)
+    columns.append(&columns_[d]);
+  if (!weights_.isEmpty())
+    columns.append(&weights_);
+
+  for (QVector<double>* column : columns)
+  {
+    TRACE_SCOPE("place column", "dataset");
+    QVector<double> placed = untouchedColumn(size_);
+    const double* from = column->constData();
+    double* to = placed.data();
+    parallelHome(size_, PlaceChunk, [&](qint64 begin, qint64 end)
+    {
+      std::copy(from + begin, from + end, to + begin);
+    });
+    *column = std::move(placed);
+  }
+}
+
+// One pass over all columns. Chunks are merged in order, so the result does
+// not depend on the number of threads beyond floating point rounding.
+void Dataset::computeStats()
+{
+  const int dims = dimensions_;
+  double shift[3] = {0.0, 0.0, 0.0};
+  for (int d = 0; d < dims; d++)
+    for (qint32 i = 0; i < size_; i++)
+      if (!qIsNaN(data_[d][i]))
+      {
+        shift[d] = data_[d][i];
+        break;
+      }
+
+  const int chunks = parallelChunkCount(size_, StatsChunk);
+  QVector<PartialStats> partials(chunks * dims);
+  PartialStats* partial = partials.data();
+  parallelChunks(size_, StatsChunk, [&](int chunk, qint64 begin, qint64 end)
+  {
+    for (int d = 0; d < dims; d++)
+    {
+      const double* column = data_[d];
+      PartialStats p;
+      for (qint64 i = begin; i < end; i++)
+      {
+        const double v = column[i];
+        if (qIsNaN(v))
+        {
+          p.nanCount++;
+          continue;
+        }
+        p.min = qMin(p.min, v);
+        p.max = qMax(p.max, v);
+        const double s = v - shift[d];
+        p.sum += s;
+        p.sumSquares += s * s;
+        p.count++;
+      }
+      partial[chunk * dims + d] = p;
+    }
+  });
+
+  for (int d = 0; d < dims; d++)
+  {
+    PartialStats total;
+    for (int c = 0; c < chunks; c++)
+    {
+      const PartialStats& p = partial[c * dims + d];
+      total.min = qMin(total.min, p.min);
+      total.max = qMax(total.max, p.max);
+      total.sum += p.sum;
+      total.sumSquares += p.sumSquares;
+      total.count += p.count;
+      total.nanCount += p.nanCount;
+    }
+
+    DimensionStats& stats = stats_[d];
+    stats.nanCount = total.nanCount;
+    if (total.count == 0)
+      continue;
+    const double mean = total.sum / total.count;
+    stats.min = total.min;
+    stats.max = total.max;
+    stats.mean = shift[d] + mean;
+    stats.variance = qMax(0.0, total.sumSquares / total.count - mean * mean);
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <QVector>
+#include <QSharedPointer>
+
+// One loaded or generated data set, stored once as immutable columns. The
+// engine, the 2D plot and the 3D view share it through a DatasetPtr and read
+// the columns in place, so a data set costs one copy of its points plus
+// whatever the GPU holds. 2D data sets have an empty z column.
+//
+// An optional weight column gives each point a multiplicity, e.g. a count
+// per bucket of pre-aggregated input. Weights are non-negative; without the
+// column every point weighs 1.
+//
+// A data set can also stand for more rows than it has points, when exact
+// duplicates were collapsed on import (see Deduplicate): the row index then
+// holds the point of every original row.
+//
+// With NUMA placement (ThreadPool::configure()) the columns are copied once
+// so that each range sits on the node of the worker processing it.
+//
+// Per dimension statistics are computed once, in parallel, when the data set
+// is created and are what initialization and bounds read instead of
+// rescanning the points.
+struct DimensionStats
+{
+  // Over the values that are not NaN; all zero when there are none
+  double min = 0.0;
+  double max = 0.0;
+  double mean = 0.0;
+  double variance = 0.0;
+  qint64 nanCount = 0;
+};
+
+class Dataset
+{
+public:
+  Dataset(QVector<double> x, QVector<double> y,
+          QVector<double> z = QVector<double>(),
+          QVector<double> weights = QVector<double>(),
+          QVector<quint32> rowIndex = QVector<quint32>());
+
+  int dimensions() const { return dimensions_; };
+  qint32 size() const { return size_; };
+  const QVector<double>& x() const { return columns_[0]; };
+  const QVector<double>& y() const { return columns_[1]; };
+  const QVector<double>& z() const { return columns_[2]; };
+  const QVector<double>& column(int dimension) const
+  {
+    return columns_[dimension];
+  };
+  // Raw column pointers for hot loops, nullptr past dimensions()
+  const double* const* columnData() const { return data_; };
+  bool weighted() const { return !weights_.isEmpty(); };
+  // Raw weight column, nullptr when unweighted
+  const double* weights() const
+  {
+    return weights_.isEmpty() ? nullptr : weights_.constData();
+  };
+  const QVector<double>& weightColumn() const { return weights_; };
+  // Sum of the weights, size() when unweighted
+  double totalWeight() const { return totalWeight_; };
+  // Point of every original row, empty when every row is its own point
+  const QVector<quint32>& rowIndex() const { return rowIndex_; };
+  qint32 rowCount() const
+  {
+    return rowIndex_.isEmpty() ? size_ : rowIndex_.size();
+  };
+  const DimensionStats& stats(int dimension) const
+  {
+    return stats_[dimension];
+  };
+
+private:
+  QVector<double> columns_[3];
+  QVector<double> weights_;
+  QVector<quint32> rowIndex_;
+  const double* data_[3];
+  DimensionStats stats_[3];
+  double totalWeight_;
+  int dimensions_;
+  qint32 size_;
+
+  void placeColumns();
+  void computeStats();
+};
+
+typedef QSharedPointer<const Dataset> DatasetPtr;
+
+#endif // DATASET_H
@@ -0,0 +1,258 @@
+#include "DecisionRegions.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <algorithm>
+#include <numeric>
+
+DecisionRegions::DecisionRegions(QCPAxis* keyAxis, QCPAxis* valueAxis) :
+  QCPAbstractPlottable(keyAxis, valueAxis),
+  metric_(Euclidean),
+  alpha_(48),
+  imageValid_(false)
+{
+  setSelectable(QCP::stNone);
+}
+
+void DecisionRegions::setCentroids(const QVector<Pair2D>& centroids)
+{
+  centroids_ = centroids;
+  imageValid_ = false;
+}
+
+void DecisionRegions::setMetric(Metric metric)
+{
+  if (metric_ != metric)
+    imageValid_ = false;
+  metric_ = metric;
+}
+
+void DecisionRegions::setPalette(const QVector<QColor>& palette)
+{
+  palette_ = palette;
+  imageValid_ = false;
+}
+
+void DecisionRegions::setOpacity(int alpha)
+{
+  if (alpha_ != alpha)
+    imageValid_ = false;
+  alpha_ = alpha;
+}
+
+double DecisionRegions::selectTest(const QPointF& pos, bool onlySelectable,
+                                   QVariant* details) const
+{
+  Q_UNUSED(pos)
+  Q_UNUSED(onlySelectable)
+  Q_UNUSED(details)
+  return -1;
+}
+
+// The regions cover whatever is visible, so they never widen the axes
+QCPRange DecisionRegions::getKeyRange(bool& foundRange,
+                                      QCP::SignDomain inSignDomain) const
+{
+  Q_UNUSED(inSignDomain)
+  foundRange = false;
+  return QCPRange();
+}
+
+QCPRange DecisionRegions::getValueRange(bool& foundRange,
+                                        QCP::SignDomain inSignDomain,
+                                        const QCPRange& inKeyRange) const
+{
+  Q_UNUSED(inSignDomain)
+  Q_UNUSED(inKeyRange)
+  foundRange = false;
+  return QCPRange();
+}
+
+void DecisionRegions::draw(QCPPainter* painter)
+{
+  QCPAxis* keyAxis = mKeyAxis.data();
+  QCPAxis* valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis || centroids_.isEmpty() ||
+      keyAxis->orientation() != Qt::Horizontal)
+    return;
+
+  const QCPRange keyRange = keyAxis->range();
+  const QCPRange valueRange = valueAxis->range();
+  QRectF target = QRectF(coordsToPixels(keyRange.lower, valueRange.upper),
+                         coordsToPixels(keyRange.upper, valueRange.lower))
+                  .normalized();
+  QSize size = target.size().toSize();
+  if (size.isEmpty())
+    return;
+
+  if (!imageValid_ || image_.size() != size || imageKeyRange_ != keyRange ||
+      imageValueRange_ != valueRange)
+    render(keyRange, valueRange, size);
+
+  if (keyAxis->rangeReversed() || valueAxis->rangeReversed())
+    painter->drawImage(target, image_.mirrored(keyAxis->rangeReversed(),
+                                               valueAxis->rangeReversed()));
+  else
+    painter->drawImage(target, image_);
+}
+
+void DecisionRegions::drawLegendIcon(QCPPainter* painter,
+                                     const QRectF& rect) const
+{
+  QColor color = palette_.isEmpty() ? mBrush.color() : palette_.first();
+  color.setAlpha(alpha_);
+  painter->fillRect(rect, color);
+}
+
+void DecisionRegions::render(const QCPRange& keyRange,
+                             const QCPRange& valueRange, const QSize& size)
+{
+  TRACE_SCOPE("DecisionRegions::render", "gui");
+  const int w = size.width();
+  const int h = size.height();
+  const int k = centroids_.size();
+  const double pixelKey = keyRange.size() / w;
+  const double pixelValue = valueRange.size() / h;
+
+  // Plain arrays, the rows below are filled concurrently
+  QVector<double> keys(k), values(k);
+  QVector<QRgb> premultiplied(k);
+  for (int c = 0; c < k; c++)
+  {
+    keys[c] = centroids_[c][0];
+    values[c] = centroids_[c][1];
+    QColor color = palette_.value(c, Qt::gray);
+    premultiplied[c] = qPremultiply(qRgba(color.red(), color.green(),
+                                          color.blue(), alpha_));
+  }
+  const double* cx = keys.constData();
+  const double* cy = values.constData();
+  const QRgb* colors = premultiplied.constData();
+
+  // Both sweeps walk the centroids in key order. Exact ties go to the lower
+  // index, like the engine's assignment loop; the distances are rearranged
+  // below, so pixels whose distances differ only by rounding can still go
+  // either way.
+  QVector<int> byKey(k);
+  std::iota(byKey.begin(), byKey.end(), 0);
+  std::stable_sort(byKey.begin(), byKey.end(), [cx](int a, int b)
+                   { return cx[a] < cx[b]; });
+  const int* order = byKey.constData();
+
+  image_ = QImage(w, h, QImage::Format_ARGB32_Premultiplied);
+  uchar* bits = image_.bits();
+  const int bytesPerLine = image_.bytesPerLine();
+  parallelChunks(h, 16, [&](int, qint64 begin, qint64 end)
+  {
+    QVector<int> hull;
+    QVector<double> intercept(k);
+    QVector<int> nearest(w);
+    QVector<double> best(w);
+    for (qint64 py = begin; py < end; py++)
+    {
+      const double y = valueRange.upper - (py + 0.5) * pixelValue;
+      if (metric_ == Euclidean)
+      {
+        // (x - cx)^2 + (y - cy)^2 = x^2 + (-2 cx) x + cx^2 + (y - cy)^2, so
+        // the nearest centroid is the lowest of k lines in x. Lines arrive
+        // with falling slope; the envelope is queried left to right.
+        for (int c = 0; c < k; c++)
+        {
+          const double dy = y - cy[c];
+          intercept[c] = cx[c] * cx[c] + dy * dy;
+        }
+        hull.clear();
+        for (int i = 0; i < k; i++)
+        {
+          const int c = order[i];
+          const double m3 = -2 * cx[c];
+          const double b3 = intercept[c];
+          if (!hull.isEmpty() && -2 * cx[hull.last()] == m3)
+          {
+            if (intercept[hull.last()] <= b3)
+              continue;
+            hull.removeLast();
+          }
+          while (hull.size() >= 2)
+          {
+            const int l1 = hull[hull.size() - 2];
+            const int l2 = hull.last();
+            const double m1 = -2 * cx[l1];
+            const double m2 = -2 * cx[l2];
+            const double b1 = intercept[l1];
+            const double b2 = intercept[l2];
+            if ((b3 - b1) * (m1 - m2) > (b2 - b1) * (m1 - m3))
+              break;
+            hull.removeLast();
+          }
+          hull.append(c);
+        }
+
+        int at = 0;
+        for (int px = 0; px < w; px++)
+        {
+          const double x = keyRange.lower + (px + 0.5) * pixelKey;
+          while (at + 1 < hull.size())
+          {
+            const int l = hull[at], r = hull[at + 1];
+            const double current = -2 * cx[l] * x + intercept[l];
+            const double right = -2 * cx[r] * x + intercept[r];
+            if (right > current || (right == current && r > l))
+              break;
+            at++;
+          }
+          nearest[px] = hull[at];
+        }
+      }
+      else
+      {
+        // |x - cx| + |y - cy|: sweep right with the best |y - cy| - cx among
+        // centroids left of x, then left with the best |y - cy| + cx
+        int next = 0, leftBest = -1;
+        for (int px = 0; px < w; px++)
+        {
+          const double x = keyRange.lower + (px + 0.5) * pixelKey;
+          for (; next < k && cx[order[next]] <= x; next++)
+          {
+            const int c = order[next];
+            const double v = qAbs(y - cy[c]) - cx[c];
+            const double b = leftBest < 0
+                             ? 0.0 : qAbs(y - cy[leftBest]) - cx[leftBest];
+            if (leftBest < 0 || v < b || (v == b && c < leftBest))
+              leftBest = c;
+          }
+          nearest[px] = leftBest;
+          if (leftBest >= 0)
+            best[px] = x + qAbs(y - cy[leftBest]) - cx[leftBest];
+        }
+        int prev = k - 1, rightBest = -1;
+        for (int px = w - 1; px >= 0; px--)
+        {
+          const double x = keyRange.lower + (px + 0.5) * pixelKey;
+          for (; prev >= 0 && cx[order[prev]] >= x; prev--)
+          {
+            const int c = order[prev];
+            const double v = qAbs(y - cy[c]) + cx[c];
+            const double b = rightBest < 0
+                             ? 0.0 : qAbs(y - cy[rightBest]) + cx[rightBest];
+            if (rightBest < 0 || v < b || (v == b && c < rightBest))
+              rightBest = c;
+          }
+          if (rightBest < 0)
+            continue;
+          const double d = qAbs(y - cy[rightBest]) + cx[rightBest] - x;
+          if (nearest[px] < 0 || d < best[px] ||
+              (d == best[px] && rightBest < nearest[px]))
+            nearest[px] = rightBest;
+        }
+      }
+
+      QRgb* line = reinterpret_cast<QRgb*>(bits + py * bytesPerLine);
+      for (int px = 0; px < w; px++)
+        line[px] = colors[nearest[px]];
+    }
+  }, 0, ThreadPool::Low);
+
+  imageKeyRange_ = keyRange;
+  imageValueRange_ = valueRange;
+  imageValid_ = true;
+}
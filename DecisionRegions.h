@@ -0,0 +1,58 @@
+#ifndef DECISIONREGIONS_H
+#define DECISIONREGIONS_H
+
+#include <QVector>
+#include <QColor>
+#include <QImage>
+#include <qcustomplot.h>
+#include "Pair.h"
+
+// QCustomPlot plottable that shades the axis rect by nearest centroid, i.e.
+// the Voronoi cells of the current centroids under the clustering metric.
+//
+// Each pixel row is solved exactly in O(k + width) with a lower envelope
+// sweep over the centroids sorted by key, and rows are computed in parallel.
+// The image is cached and only recomputed when the centroids, metric,
+// palette, axis ranges or plot size change.
+class DecisionRegions : public QCPAbstractPlottable
+{
+public:
+  enum Metric {Euclidean, L1};
+
+  DecisionRegions(QCPAxis* keyAxis, QCPAxis* valueAxis);
+
+  void setCentroids(const QVector<Pair2D>& centroids);
+  void setMetric(Metric metric);
+  void setPalette(const QVector<QColor>& palette);
+  void setOpacity(int alpha);
+
+  virtual double selectTest(const QPointF& pos, bool onlySelectable,
+                            QVariant* details = nullptr) const override;
+  virtual QCPRange getKeyRange(bool& foundRange,
+                               QCP::SignDomain inSignDomain = QCP::sdBoth)
+                               const override;
+  virtual QCPRange getValueRange(bool& foundRange,
+                                 QCP::SignDomain inSignDomain = QCP::sdBoth,
+                                 const QCPRange& inKeyRange = QCPRange())
+                                 const override;
+
+protected:
+  virtual void draw(QCPPainter* painter) override;
+  virtual void drawLegendIcon(QCPPainter* painter,
+                              const QRectF& rect) const override;
+
+private:
+  QVector<Pair2D> centroids_;
+  QVector<QColor> palette_;
+  Metric metric_;
+  int alpha_;
+
+  QImage image_;
+  bool imageValid_;
+  QCPRange imageKeyRange_, imageValueRange_;
+
+  void render(const QCPRange& keyRange, const QCPRange& valueRange,
+              const QSize& size);
+};
+
+#endif // DECISIONREGIONS_H
@@ -0,0 +1,188 @@
+#include "Deduplicate.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <cstring>
+
+namespace
+{
+const qint64 RowChunk = 1 << 16;
+// Top hash bits pick the partition
+const int PartitionBits = 8;
+const int Partitions = 1 << PartitionBits;
+
+quint64 bitsOf(double v)
+{
+  v += 0.0;
+  quint64 bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+quint64 mix(quint64 h)
+{
+  h ^= h >> 30;
+  h *= 0xBF58476D1CE4E5B9ull;
+  h ^= h >> 27;
+  h *= 0x94D049BB133111EBull;
+  return h ^ (h >> 31);
+}
+
+quint64 hashRow(const double* const* columns, int dims, qint64 row)
+{
+  quint64 h = 0;
+  for (int d = 0; d < dims; d++)
+    h = mix(h ^ bitsOf(columns[d][row]));
+  return h;
+}
+
+bool sameRow(const double* const* columns, int dims, qint64 a, qint64 b)
+{
+  for (int d = 0; d < dims; d++)
+    if (bitsOf(columns[d][a]) != bitsOf(columns[d][b]))
+      return false;
+  return true;
+}
+
+struct Partition
+{
+  // First row of each unique point and its total weight
+  QVector<qint32> firstRows;
+  QVector<double> weights;
+};
+}
+
+DatasetPtr Deduplicate::Collapse(const DatasetPtr& data)
+{
+  TRACE_SCOPE("deduplicate", "import");
+  const int dims = data->dimensions();
+  const qint32 n = data->size();
+  const double* const* columns = data->columnData();
+  const double* w = data->weights();
+
+  // Rows grouped by partition, in row order within each: every chunk counts
+  // its rows per partition, then writes them behind the earlier chunks'
+  const int chunks = parallelChunkCount(n, RowChunk);
+  QVector<qint32> counts(chunks * Partitions);
+  qint32* count = counts.data();
+  parallelChunks(n, RowChunk, [&](int chunk, qint64 begin, qint64 end)
+  {
+    qint32* own = count + chunk * Partitions;
+    for (qint64 i = begin; i < end; i++)
+      own[hashRow(columns, dims, i) >> (64 - PartitionBits)]++;
+  });
+  QVector<qint32> partitionStart(Partitions + 1);
+  qint32 offset = 0;
+  for (int p = 0; p < Partitions; p++)
+  {
+    partitionStart[p] = offset;
+    for (int c = 0; c < chunks; c++)
+    {
+      const qint32 rows = count[c * Partitions + p];
+      count[c * Partitions + p] = offset;
+      offset += rows;
+    }
+  }
+  partitionStart[Partitions] = n;
+
+  QVector<qint32> order(n);
+  qint32* ordered = order.data();
+  parallelChunks(n, RowChunk, [&](int chunk, qint64 begin, qint64 end)
+  {
+    qint32* cursor = count + chunk * Partitions;
+    for (qint64 i = begin; i < end; i++)
+      ordered[cursor[hashRow(columns, dims, i) >> (64 - PartitionBits)]++] =
+        qint32(i);
+  });
+
+  // Each partition in its own open addressing table. rowIndex holds the
+  // partition's unique point of each row until the partitions are numbered.
+  QVector<quint32> rowIndex(n);
+  quint32* index = rowIndex.data();
+  QVector<Partition> partitions(Partitions);
+  Partition* partition = partitions.data();
+  const qint32* start = partitionStart.constData();
+  parallelFor(Partitions, 1, [&](qint64 first, qint64 last)
+  {
+    for (qint64 p = first; p < last; p++)
+    {
+      const qint32 rows = start[p + 1] - start[p];
+      int capacity = 16;
+      while (capacity < 2 * rows)
+        capacity *= 2;
+      QVector<qint32> slots(capacity, -1);
+      Partition& own = partition[p];
+      for (qint32 r = start[p]; r < start[p + 1]; r++)
+      {
+        const qint32 row = ordered[r];
+        const double weight = w ? w[row] : 1.0;
+        int slot = int(hashRow(columns, dims, row) & quint64(capacity - 1));
+        while (slots[slot] >= 0 &&
+               !sameRow(columns, dims, own.firstRows[slots[slot]], row))
+          slot = (slot + 1) & (capacity - 1);
+        if (slots[slot] < 0)
+        {
+          slots[slot] = own.firstRows.size();
+          own.firstRows.append(row);
+          own.weights.append(weight);
+        }
+        else
+          own.weights[slots[slot]] += weight;
+        index[row] = quint32(slots[slot]);
+      }
+    }
+  });
+
+  QVector<qint32> uniqueStart(Partitions + 1);
+  qint32 unique = 0;
+  for (int p = 0; p < Partitions; p++)
+  {
+    uniqueStart[p] = unique;
+    unique += partitions[p].firstRows.size();
+  }
+  uniqueStart[Partitions] = unique;
+  if (unique == n)
+    return data;
+
+  // Unique points and the final row index, one partition at a time
+  QVector<double> points[3];
+  for (int d = 0; d < dims; d++)
+    points[d].resize(unique);
+  QVector<double> weights(unique);
+  double* point[3] = {points[0].data(), points[1].data(), points[2].data()};
+  double* weight = weights.data();
+  const qint32* base = uniqueStart.constData();
+  parallelFor(Partitions, 1, [&](qint64 first, qint64 last)
+  {
+    for (qint64 p = first; p < last; p++)
+    {
+      const Partition& own = partition[p];
+      for (int u = 0; u < own.firstRows.size(); u++)
+      {
+        for (int d = 0; d < dims; d++)
+          point[d][base[p] + u] = columns[d][own.firstRows[u]];
+        weight[base[p] + u] = own.weights[u];
+      }
+      for (qint32 r = start[p]; r < start[p + 1]; r++)
+        index[ordered[r]] += quint32(base[p]);
+    }
+  });
+
+  // Rows of a collapsed data set map through its index as well
+  const QVector<quint32>& earlier = data->rowIndex();
+  if (!earlier.isEmpty())
+  {
+    QVector<quint32> chained(earlier.size());
+    const quint32* from = earlier.constData();
+    quint32* to = chained.data();
+    parallelFor(earlier.size(), RowChunk, [&](qint64 begin, qint64 end)
+    {
+      for (qint64 i = begin; i < end; i++)
+        to[i] = index[from[i]];
+    });
+    rowIndex = std::move(chained);
+  }
+
+  return DatasetPtr(new Dataset(std::move(points[0]), std::move(points[1]),
+                                std::move(points[2]), std::move(weights),
+                                std::move(rowIndex)));
+}
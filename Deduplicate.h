@@ -0,0 +1,23 @@
+#ifndef DEDUPLICATE_H
+#define DEDUPLICATE_H
+
+#include "Dataset.h"
+
+// Collapses points with exactly the same coordinates into one point weighted
+// by their total weight. The result keeps the point of every original row in
+// its row index, so assignments can be reported per row
+// (kmeans<T>::rowAssignments()). Clustering the collapsed data set gives the
+// same centroids and energy as clustering the rows, up to rounding.
+//
+// Points are hashed on their coordinate bits, with -0 read as 0, and split
+// into hash partitions that are deduplicated in parallel. The unique points
+// are ordered by partition and by first row within one, which only depends
+// on the data, not on the number of threads.
+class Deduplicate
+{
+public:
+  // Returns data itself when it has no duplicates
+  static DatasetPtr Collapse(const DatasetPtr& data);
+};
+
+#endif // DEDUPLICATE_H
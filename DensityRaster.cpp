@@ -0,0 +1,370 @@
+#include "DensityRaster.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+const quint32 NoCluster = std::numeric_limits<quint32>::max();
+const qint64 BinChunk = 1 << 16;
+const int MaxBinChunks = 8;
+}
+
+DensityRaster::DensityRaster()
+{
+}
+
+void DensityRaster::invalidate()
+{
+  world_.valid = false;
+  view_.valid = false;
+}
+
+qint64 DensityRaster::countInRange(const QVector<double>& keys,
+                                   const QVector<double>& values,
+                                   const QVector<quint32>& clusters,
+                                   const QCPRange& keyRange,
+                                   const QCPRange& valueRange)
+{
+  ensureWorld(keys, values, clusters);
+  if (world_.counts.isEmpty())
+    return 0;
+
+  // Cells cut by the range border are counted whole
+  const double sx = world_.width / world_.keyRange.size();
+  const double sy = world_.height / world_.valueRange.size();
+  int x0 = qBound(0, int((keyRange.lower - world_.keyRange.lower) * sx), world_.width - 1);
+  int x1 = qBound(0, int((keyRange.upper - world_.keyRange.lower) * sx), world_.width - 1);
+  int y0 = qBound(0, int((valueRange.lower - world_.valueRange.lower) * sy), world_.height - 1);
+  int y1 = qBound(0, int((valueRange.upper - world_.valueRange.lower) * sy), world_.height - 1);
+  if (keyRange.upper < world_.keyRange.lower || keyRange.lower > world_.keyRange.upper ||
+      valueRange.upper < world_.valueRange.lower || valueRange.lower > world_.valueRange.upper)
+    return 0;
+
+  qint64 count = 0;
+  for (int y = y0; y <= y1; y++)
+  {
+    const quint32* row = world_.counts.constData() + qint64(y) * world_.width;
+    for (int x = x0; x <= x1; x++)
+      count += row[x];
+  }
+  return count;
+}
+
+QImage DensityRaster::render(const QVector<double>& keys,
+                             const QVector<double>& values,
+                             const QVector<quint32>& clusters,
+                             const QVector<QColor>& palette,
+                             const QCPRange& keyRange,
+                             const QCPRange& valueRange, const QSize& size)
+{
+  TRACE_SCOPE("DensityRaster::render", "gui");
+  if (size.isEmpty() || keyRange.size() <= 0 || valueRange.size() <= 0)
+    return QImage();
+  ensureWorld(keys, values, clusters);
+
+  const int w = size.width();
+  const int h = size.height();
+  const double pixelKey = keyRange.size() / w;
+  const double pixelValue = valueRange.size() / h;
+
+  // The world grid is only resampled while its cells are at most two pixels
+  // wide, past that the visible range is binned at pixel resolution
+  const Grid* source = &world_;
+  if (world_.counts.isEmpty() ||
+      world_.keyRange.size() / world_.width > 2 * pixelKey ||
+      world_.valueRange.size() / world_.height > 2 * pixelValue)
+  {
+    if (!view_.valid || view_.width != w || view_.height != h ||
+        view_.keyRange != keyRange || view_.valueRange != valueRange)
+    {
+      view_.keyRange = keyRange;
+      view_.valueRange = valueRange;
+      view_.width = w;
+      view_.height = h;
+      bin(view_, keys, values, clusters);
+    }
+    source = &view_;
+  }
+
+  const double cellKey = source->keyRange.size() / source->width;
+  const double cellValue = source->valueRange.size() / source->height;
+  QVector<float> densities(w * h, 0.0f);
+  QVector<quint32> pixelClusters(w * h, NoCluster);
+  float* density = densities.data();
+  quint32* cluster = pixelClusters.data();
+
+  if (cellKey >= pixelKey && cellValue >= pixelValue)
+  {
+    // Cells at least as large as pixels: each pixel reads the cell under its
+    // center, scaled to the pixel area
+    const float scale = float((pixelKey * pixelValue) / (cellKey * cellValue));
+    parallelChunks(h, 64, [&](int, qint64 begin, qint64 end)
+    {
+      for (qint64 py = begin; py < end; py++)
+      {
+        double v = valueRange.upper - (py + 0.5) * pixelValue;
+        int cy = int(std::floor((v - source->valueRange.lower) / cellValue));
+        if (cy < 0 || cy >= source->height)
+          continue;
+        for (int px = 0; px < w; px++)
+        {
+          double k = keyRange.lower + (px + 0.5) * pixelKey;
+          int cx = int(std::floor((k - source->keyRange.lower) / cellKey));
+          if (cx < 0 || cx >= source->width)
+            continue;
+          qint64 cell = qint64(cy) * source->width + cx;
+          density[py * w + px] = source->counts[cell] * scale;
+          cluster[py * w + px] = source->clusters[cell];
+        }
+      }
+    }, 0, ThreadPool::Low);
+  }
+  else
+  {
+    // Cells smaller than pixels: each cell adds into the pixel under its
+    // center, the pixel takes the cluster of its fullest cell
+    QVector<quint32> fullest(w * h, 0);
+    for (int cy = 0; cy < source->height; cy++)
+    {
+      double v = source->valueRange.lower + (cy + 0.5) * cellValue;
+      int py = int(std::floor((valueRange.upper - v) / pixelValue));
+      if (py < 0 || py >= h)
+        continue;
+      for (int cx = 0; cx < source->width; cx++)
+      {
+        quint32 count = source->counts[qint64(cy) * source->width + cx];
+        if (!count)
+          continue;
+        double k = source->keyRange.lower + (cx + 0.5) * cellKey;
+        int px = int(std::floor((k - keyRange.lower) / pixelKey));
+        if (px < 0 || px >= w)
+          continue;
+        density[py * w + px] += count;
+        if (count >= fullest[py * w + px])
+        {
+          fullest[py * w + px] = count;
+          cluster[py * w + px] = source->clusters[qint64(cy) * source->width + cx];
+        }
+      }
+    }
+  }
+
+  // Log scaled alpha keeps single points visible next to dense cores
+  float maxDensity = 0;
+  for (float d : densities)
+    maxDensity = qMax(maxDensity, d);
+  const float norm = maxDensity > 0 ? 1.0f / std::log1p(maxDensity) : 0.0f;
+
+  QImage image(w, h, QImage::Format_ARGB32_Premultiplied);
+  uchar* bits = image.bits();
+  const int bytesPerLine = image.bytesPerLine();
+  parallelChunks(h, 64, [&](int, qint64 begin, qint64 end)
+  {
+    for (qint64 py = begin; py < end; py++)
+    {
+      QRgb* line = reinterpret_cast<QRgb*>(bits + py * bytesPerLine);
+      for (int px = 0; px < w; px++)
+      {
+        float d = density[py * w + px];
+        if (d <= 0)
+        {
+          line[px] = 0;
+          continue;
+        }
+        quint32 c = cluster[py * w + px];
+        QRgb rgb = c < quint32(palette.size()) ? palette[c].rgb() : qRgb(128, 128, 128);
+        int alpha = 64 + int(191 * qMin(1.0f, std::log1p(d) * norm));
+        line[px] = qPremultiply(qRgba(qRed(rgb), qGreen(rgb), qBlue(rgb), alpha));
+      }
+    }
+  }, 0, ThreadPool::Low);
+  return image;
+}
+
+void DensityRaster::ensureWorld(const QVector<double>& keys,
+                                const QVector<double>& values,
+                                const QVector<quint32>& clusters)
+{
+  if (world_.valid)
+    return;
+  TRACE_SCOPE("DensityRaster::ensureWorld", "gui");
+
+  const qint64 n = qMin(keys.size(), values.size());
+  const int chunks = parallelChunkCount(n, BinChunk);
+  QVector<QCPRange> keyRanges(chunks), valueRanges(chunks);
+  QVector<char> founds(chunks, false);
+  QCPRange* keyBounds = keyRanges.data();
+  QCPRange* valueBounds = valueRanges.data();
+  char* found = founds.data();
+  parallelChunks(n, BinChunk, [&](int chunk, qint64 begin, qint64 end)
+  {
+    for (qint64 i = begin; i < end; i++)
+    {
+      if (qIsNaN(keys[i]) || qIsNaN(values[i]))
+        continue;
+      if (!found[chunk])
+      {
+        keyBounds[chunk] = QCPRange(keys[i], keys[i]);
+        valueBounds[chunk] = QCPRange(values[i], values[i]);
+        found[chunk] = true;
+      }
+      keyBounds[chunk].expand(keys[i]);
+      valueBounds[chunk].expand(values[i]);
+    }
+  }, 0, ThreadPool::Low);
+
+  bool any = false;
+  for (int c = 0; c < chunks; c++)
+  {
+    if (!found[c])
+      continue;
+    if (!any)
+    {
+      world_.keyRange = keyBounds[c];
+      world_.valueRange = valueBounds[c];
+      any = true;
+    }
+    world_.keyRange.expand(keyBounds[c]);
+    world_.valueRange.expand(valueBounds[c]);
+  }
+
+  world_.valid = true;
+  if (!any)
+  {
+    world_.width = world_.height = 0;
+    world_.counts.clear();
+    world_.clusters.clear();
+    return;
+  }
+
+  // Degenerate extents still get one cell, the upper bound is pushed out so
+  // the maximum lands inside the last cell
+  const double padKey = world_.keyRange.size() > 0 ? world_.keyRange.size() * 1e-9 : 0.5;
+  const double padValue = world_.valueRange.size() > 0 ? world_.valueRange.size() * 1e-9 : 0.5;
+  world_.keyRange.upper += padKey;
+  world_.valueRange.upper += padValue;
+  world_.width = world_.height = WorldResolution;
+  bin(world_, keys, values, clusters);
+}
+
+void DensityRaster::bin(Grid& grid, const QVector<double>& keys,
+                        const QVector<double>& values,
+                        const QVector<quint32>& clusters)
+{
+  TRACE_SCOPE("DensityRaster::bin", "gui");
+  const qint64 n = qMin(keys.size(), values.size());
+  const qint64 cells = qint64(grid.width) * grid.height;
+  const double sx = grid.width / grid.keyRange.size();
+  const double sy = grid.height / grid.valueRange.size();
+  auto cellOf = [&](qint64 i)
+  {
+    double x = (keys[i] - grid.keyRange.lower) * sx;
+    double y = (values[i] - grid.valueRange.lower) * sy;
+    if (!(x >= 0 && x < grid.width && y >= 0 && y < grid.height))
+      return qint64(-1);
+    return qint64(y) * grid.width + qint64(x);
+  };
+
+  // Each chunk counts its points per cell
+  const int chunks = parallelChunkCount(n, BinChunk, MaxBinChunks);
+  QVector<QVector<quint32>> chunkCounts(chunks);
+  QVector<quint32>* counts = chunkCounts.data();
+  parallelChunks(n, BinChunk, [&](int chunk, qint64 begin, qint64 end)
+  {
+    counts[chunk].fill(0, int(cells));
+    quint32* count = counts[chunk].data();
+    for (qint64 i = begin; i < end; i++)
+    {
+      const qint64 cell = cellOf(i);
+      if (cell >= 0)
+        count[cell]++;
+    }
+  }, MaxBinChunks, ThreadPool::Low);
+  QVector<quint32*> chunkCount(chunks);
+  for (int c = 0; c < chunks; c++)
+    chunkCount[c] = counts[c].data();
+  quint32* const* count = chunkCount.constData();
+
+  grid.counts.resize(int(cells));
+  quint32* gridCounts = grid.counts.data();
+  parallelChunks(cells, BinChunk, [&](int, qint64 begin, qint64 end)
+  {
+    for (qint64 cell = begin; cell < end; cell++)
+    {
+      quint32 total = 0;
+      for (int c = 0; c < chunks; c++)
+        total += count[c][cell];
+      gridCounts[cell] = total;
+    }
+  }, 0, ThreadPool::Low);
+  QVector<quint32> cellStarts(int(cells) + 1);
+  quint32* starts = cellStarts.data();
+  quint32 offset = 0;
+  for (qint64 cell = 0; cell < cells; cell++)
+  {
+    starts[cell] = offset;
+    offset += gridCounts[cell];
+  }
+  starts[cells] = offset;
+
+  // The clusters of every cell's points side by side, then each cell takes
+  // the cluster most of its points are in. Ties go to the lower index, so the
+  // color doesn't depend on the order of the points.
+  parallelChunks(cells, BinChunk, [&](int, qint64 begin, qint64 end)
+  {
+    for (qint64 cell = begin; cell < end; cell++)
+    {
+      quint32 cursor = starts[cell];
+      for (int c = 0; c < chunks; c++)
+      {
+        const quint32 points = count[c][cell];
+        count[c][cell] = cursor;
+        cursor += points;
+      }
+    }
+  }, 0, ThreadPool::Low);
+  QVector<quint32> cellMembers;
+  cellMembers.resize(int(offset));
+  quint32* members = cellMembers.data();
+  parallelChunks(n, BinChunk, [&](int chunk, qint64 begin, qint64 end)
+  {
+    quint32* cursor = count[chunk];
+    for (qint64 i = begin; i < end; i++)
+    {
+      const qint64 cell = cellOf(i);
+      if (cell >= 0)
+        members[cursor[cell]++] = i < clusters.size() ? clusters[i]
+                                                      : NoCluster;
+    }
+  }, MaxBinChunks, ThreadPool::Low);
+  chunkCounts.clear();
+
+  grid.clusters.resize(int(cells));
+  quint32* gridClusters = grid.clusters.data();
+  parallelChunks(cells, BinChunk, [&](int, qint64 begin, qint64 end)
+  {
+    for (qint64 cell = begin; cell < end; cell++)
+    {
+      quint32* first = members + starts[cell];
+      quint32* last = members + starts[cell + 1];
+      std::sort(first, last);
+      quint32 dominant = NoCluster;
+      qint64 most = 0;
+      for (quint32* run = first; run != last;)
+      {
+        quint32* next = std::upper_bound(run, last, *run);
+        if (next - run > most)
+        {
+          dominant = *run;
+          most = next - run;
+        }
+        run = next;
+      }
+      gridClusters[cell] = dominant;
+    }
+  }, 0, ThreadPool::Low);
+  grid.valid = true;
+}
@@ -0,0 +1,55 @@
+#ifndef DENSITYRASTER_H
+#define DENSITYRASTER_H
+
+#include <QVector>
+#include <QColor>
+#include <QImage>
+#include <QSize>
+#include <qcustomplot.h>
+
+// Level of detail for very large scatter plots. Points are binned, in
+// parallel, into a count grid with the dominant cluster of every cell, the
+// one most of its points are in, and the grid is resampled into an image at
+// screen resolution.
+//
+// A world grid over the whole data set is kept until the data or clusters
+// change, so panning and zooming out only resample it. When the view is
+// zoomed in past its resolution, a second grid over the visible range is
+// binned at pixel resolution.
+class DensityRaster
+{
+public:
+  static const int WorldResolution = 1024;
+
+  DensityRaster();
+
+  void invalidate();
+  qint64 countInRange(const QVector<double>& keys,
+                      const QVector<double>& values,
+                      const QVector<quint32>& clusters,
+                      const QCPRange& keyRange, const QCPRange& valueRange);
+  QImage render(const QVector<double>& keys, const QVector<double>& values,
+                const QVector<quint32>& clusters,
+                const QVector<QColor>& palette, const QCPRange& keyRange,
+                const QCPRange& valueRange, const QSize& size);
+
+private:
+  struct Grid
+  {
+    QCPRange keyRange, valueRange;
+    int width = 0, height = 0;
+    bool valid = false;
+    QVector<quint32> counts;
+    QVector<quint32> clusters;
+  };
+
+  Grid world_, view_;
+
+  void ensureWorld(const QVector<double>& keys, const QVector<double>& values,
+                   const QVector<quint32>& clusters);
+  static void bin(Grid& grid, const QVector<double>& keys,
+                  const QVector<double>& values,
+                  const QVector<quint32>& clusters);
+};
+
+#endif // DENSITYRASTER_H
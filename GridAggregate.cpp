@@ -0,0 +1,190 @@
+#include "GridAggregate.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+namespace
+{
+const qint64 PointGrain = 1 << 16;
+const qint64 CellGrain = 1 << 10;
+
+// Cells per dimension for about budget cubes over the data's extent.
+// Dimensions thinner than one cube get a single cell and leave the budget
+// to the others.
+void gridShape(const Dataset& data, qint64 budget, int* cells)
+{
+  const int dims = data.dimensions();
+  double extent[3];
+  bool flat[3];
+  for (int d = 0; d < dims; d++)
+  {
+    extent[d] = data.stats(d).max - data.stats(d).min;
+    flat[d] = !(extent[d] > 0.0);
+  }
+
+  double side = 0.0;
+  for (int pass = 0; pass < dims; pass++)
+  {
+    double volume = 1.0;
+    int free = 0;
+    for (int d = 0; d < dims; d++)
+      if (!flat[d])
+      {
+        volume *= extent[d];
+        free++;
+      }
+    if (free == 0)
+      break;
+    side = std::pow(volume / double(budget), 1.0 / free);
+    bool thin = false;
+    for (int d = 0; d < dims; d++)
+      if (!flat[d] && extent[d] < side)
+        flat[d] = thin = true;
+    if (!thin)
+      break;
+  }
+
+  for (int d = 0; d < dims; d++)
+    cells[d] = flat[d] ? 1 : int(qBound(1.0, extent[d] / side,
+                                        double(budget)));
+}
+}
+
+GridAggregate::Result GridAggregate::Build(const Dataset& data,
+                                           const Options& options)
+{
+  TRACE_SCOPE("grid aggregate", "reduce");
+  Result result;
+  const int dims = data.dimensions();
+  const qint32 n = data.size();
+  const qint64 budget = qBound<qint64>(1, n / qMax(1, options.pointsPerCell),
+                                       qMax(1, options.maxCells));
+  gridShape(data, budget, result.resolution);
+
+  double origin[3], scale[3];
+  qint64 total = 1;
+  for (int d = 0; d < dims; d++)
+  {
+    const DimensionStats& stats = data.stats(d);
+    origin[d] = stats.min;
+    scale[d] = stats.max > stats.min
+               ? result.resolution[d] / (stats.max - stats.min) : 0.0;
+    total *= result.resolution[d];
+  }
+
+  // Cell of every point, row major, and the points per cell. NaN
+  // coordinates fall into the first cell of their dimension.
+  const int* resolution = result.resolution;
+  const double* const* columns = data.columnData();
+  result.cellOf.resize(n);
+  quint32* cellOf = result.cellOf.data();
+  std::unique_ptr<std::atomic<quint32>[]> counts(
+    new std::atomic<quint32>[size_t(total)]);
+  std::atomic<quint32>* count = counts.get();
+  parallelFor(total, PointGrain, [count](qint64 begin, qint64 end)
+  {
+    for (qint64 c = begin; c < end; c++)
+      count[c].store(0, std::memory_order_relaxed);
+  });
+  parallelFor(n, PointGrain, [&](qint64 begin, qint64 end)
+  {
+    for (qint64 i = begin; i < end; i++)
+    {
+      quint32 cell = 0;
+      for (int d = dims - 1; d >= 0; d--)
+      {
+        const double t = (columns[d][i] - origin[d]) * scale[d];
+        const int bin = t > 0.0 ? int(qMin(t, double(resolution[d] - 1)))
+                                : 0;
+        cell = cell * quint32(resolution[d]) + quint32(bin);
+      }
+      cellOf[i] = cell;
+      count[cell].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  // Occupied cells in grid order, each with the start of its points in
+  // order. The counts become the fill cursors.
+  QVector<quint32> rank;
+  rank.resize(int(total));
+  QVector<qint32> starts;
+  qint32 offset = 0;
+  for (qint64 c = 0; c < total; c++)
+  {
+    const quint32 points = count[c].load(std::memory_order_relaxed);
+    if (points == 0)
+      continue;
+    rank[int(c)] = quint32(starts.size());
+    starts.append(offset);
+    count[c].store(quint32(offset), std::memory_order_relaxed);
+    offset += qint32(points);
+  }
+  const int occupied = starts.size();
+  starts.append(n);
+
+  // Points grouped by cell, cellOf renumbered to occupied cells
+  QVector<qint32> order(n);
+  qint32* ordered = order.data();
+  const quint32* ranks = rank.constData();
+  parallelFor(n, PointGrain, [&](qint64 begin, qint64 end)
+  {
+    for (qint64 i = begin; i < end; i++)
+    {
+      const quint32 cell = cellOf[i];
+      ordered[count[cell].fetch_add(1, std::memory_order_relaxed)] =
+        qint32(i);
+      cellOf[i] = ranks[cell];
+    }
+  });
+  counts.reset();
+
+  // Cell means, summed in point order relative to the cell's first point
+  // so the result doesn't depend on how the points were grouped
+  QVector<double> means[3];
+  for (int d = 0; d < dims; d++)
+    means[d].resize(occupied);
+  QVector<double> weights(occupied);
+  double* mean[3] = {means[0].data(), means[1].data(), means[2].data()};
+  double* weight = weights.data();
+  const double* w = data.weights();
+  const qint32* start = starts.constData();
+  parallelFor(occupied, CellGrain, [&](qint64 begin, qint64 end)
+  {
+    for (qint64 c = begin; c < end; c++)
+    {
+      qint32* first = ordered + start[c];
+      qint32* last = ordered + start[c + 1];
+      std::sort(first, last);
+      double sum[3] = {0.0, 0.0, 0.0};
+      double weightSum = 0.0;
+      for (qint32* p = first; p != last; p++)
+      {
+        const double pw = w ? w[*p] : 1.0;
+        for (int d = 0; d < dims; d++)
+          sum[d] += pw * (columns[d][*p] - columns[d][*first]);
+        weightSum += pw;
+      }
+      // Zero weight cells keep their plain mean
+      double divisor = weightSum;
+      if (!(weightSum > 0.0))
+      {
+        for (qint32* p = first; p != last; p++)
+          for (int d = 0; d < dims; d++)
+            sum[d] += columns[d][*p] - columns[d][*first];
+        divisor = double(last - first);
+      }
+      for (int d = 0; d < dims; d++)
+        mean[d][c] = columns[d][*first] + sum[d] / divisor;
+      weight[c] = weightSum;
+    }
+  });
+
+  result.cells = DatasetPtr(new Dataset(std::move(means[0]),
+                                        std::move(means[1]),
+                                        std::move(means[2]),
+                                        std::move(weights)));
+  return result;
+}
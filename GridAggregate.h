@@ -0,0 +1,38 @@
+#ifndef GRIDAGGREGATE_H
+#define GRIDAGGREGATE_H
+
+#include <QVector>
+#include "Dataset.h"
+
+// Pre-aggregation of large 2D and 3D data sets. The bounding box is split
+// into a grid whose cells are about equally long in every dimension, so
+// flat data gets fewer cells across its thin side. Every point is binned in
+// one parallel pass and each occupied cell becomes one point of a weighted
+// data set: the mean of its points, weighted by their total weight.
+//
+// cellOf maps every point back to its cell, which is what bounds the error
+// (see kmeans<T>::setReduction()). The result only depends on the data, not
+// on the number of threads.
+class GridAggregate
+{
+public:
+  struct Options
+  {
+    // Upper bound on the cells of the grid
+    qint32 maxCells = 1 << 18;
+    // Smaller data sets get about this many points per cell instead
+    qint32 pointsPerCell = 16;
+  };
+
+  struct Result
+  {
+    DatasetPtr cells;
+    // Row of cells for each point of the data set
+    QVector<quint32> cellOf;
+    int resolution[3] = {1, 1, 1};
+  };
+
+  static Result Build(const Dataset& data, const Options& options);
+};
+
+#endif // GRIDAGGREGATE_H
@@ -19,3 +19,30 @@ void Info::ChangeInfo(qint32 step, double energy, QString reason)
   ui->energyDisplay->setText(QString::number(energy));
   ui->reasonDisplay->setText(reason);
 }
+
+void Info::ChangeStats(const KMeansStats& stats)
+{
+  QString text;
+  text += QString("Init: %1 ms\n").arg(stats.initNs / 1e6, 0, 'f', 3);
+  text += QString("Assign: %1 ms\n").arg(stats.assignNs / 1e6, 0, 'f', 3);
+  text += QString("Update: %1 ms\n").arg(stats.updateNs / 1e6, 0, 'f', 3);
+  text += QString("Distances: %1 (%2 skipped)\n")
+            .arg(stats.distanceEvaluations).arg(stats.distancesSkipped);
+  text += QString("Reassigned: %1\n").arg(stats.pointsReassigned);
+  text += QString("Empty clusters: %1\n").arg(stats.emptyClusters);
+  text += QString("Max centroid shift: %1\n").arg(stats.maxCentroidShift);
+  text += QString("Threads: %1").arg(stats.threadsUsed);
+  if (stats.reducedPoints > 0)
+  {
+    text += QString("\nReduced: %1 points, energy %2")
+              .arg(stats.reducedPoints).arg(stats.reducedEnergy);
+    if (stats.reductionBound >= 0.0)
+      text += QString(" +/- %1").arg(stats.reductionBound);
+  }
+  ui->statsDisplay->setText(text);
+}
+
+void Info::ClearStats()
+{
+  ui->statsDisplay->clear();
+}
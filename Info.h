@@ -2,6 +2,7 @@
 #define INFO_H
 
 #include <QDialog>
+#include <kmeans.h>
 
 namespace Ui {
 class Info;
@@ -15,6 +16,8 @@ public:
   explicit Info(QWidget *parent = nullptr);
   ~Info();
   void ChangeInfo(qint32 step, double energy, QString reason = "");
+  void ChangeStats(const KMeansStats& stats);
+  void ClearStats();
 
 private:
   Ui::Info *ui;
@@ -0,0 +1,228 @@
+#ifndef KMEANSHISTORY_CPP
+#define KMEANSHISTORY_CPP
+
+#include "KMeansHistory.h"
+
+template <class T>
+KMeansHistory<T>::KMeansHistory(qint64 memoryCap, int keyframeInterval)
+{
+  memoryCap_ = memoryCap;
+  keyframeInterval_ = keyframeInterval;
+  clear();
+}
+
+template <class T>
+void KMeansHistory<T>::clear()
+{
+  entries_.clear();
+  assignments_.clear();
+  position_ = -1;
+  sinceKeyframe_ = 0;
+  memoryUsed_ = 0;
+}
+
+// Appends the step that produced the given state. Recording after stepping
+// back drops the entries that were ahead of the current position.
+template <class T>
+void KMeansHistory<T>::record(const KMeansDelta& delta,
+                              const QVector<T>& centroids,
+                              const QVector<quint32>& assignments,
+                              double energy)
+{
+  truncateFuture();
+
+  Entry entry;
+  entry.iteration = delta.iteration;
+  entry.energy = energy;
+  entry.full = delta.full || entries_.isEmpty();
+  entry.centroids = centroids;
+
+  if (entry.full || ++sinceKeyframe_ >= keyframeInterval_)
+  {
+    entry.keyframe = assignments;
+    sinceKeyframe_ = 0;
+  }
+  if (!entry.full)
+    entry.changes = delta.changes;
+
+  // Keep the working copy in step with the newest entry
+  if (!entry.keyframe.isEmpty())
+    assignments_ = entry.keyframe;
+  else
+    for (const AssignmentChange& change : entry.changes)
+      assignments_[change.point] = change.to;
+
+  memoryUsed_ += entrySize(entry);
+  entries_.append(entry);
+  position_ = entries_.size() - 1;
+  trimToCap();
+}
+
+template <class T>
+bool KMeansHistory<T>::isEmpty() const
+{
+  return entries_.isEmpty();
+}
+
+template <class T>
+bool KMeansHistory<T>::canStepBack() const
+{
+  return position_ > 0;
+}
+
+template <class T>
+bool KMeansHistory<T>::canStepForward() const
+{
+  return position_ >= 0 && position_ < entries_.size() - 1;
+}
+
+template <class T>
+bool KMeansHistory<T>::stepBack()
+{
+  if (!canStepBack())
+    return false;
+  moveTo(position_ - 1);
+  return true;
+}
+
+template <class T>
+bool KMeansHistory<T>::stepForward()
+{
+  if (!canStepForward())
+    return false;
+  moveTo(position_ + 1);
+  return true;
+}
+
+template <class T>
+bool KMeansHistory<T>::seek(quint32 iteration)
+{
+  for (int i = 0; i < entries_.size(); i++)
+  {
+    if (entries_[i].iteration == iteration)
+    {
+      moveTo(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class T>
+quint32 KMeansHistory<T>::firstIteration() const
+{
+  return entries_.isEmpty() ? 0 : entries_.first().iteration;
+}
+
+template <class T>
+quint32 KMeansHistory<T>::lastIteration() const
+{
+  return entries_.isEmpty() ? 0 : entries_.last().iteration;
+}
+
+template <class T>
+quint32 KMeansHistory<T>::iteration() const
+{
+  return entries_[position_].iteration;
+}
+
+template <class T>
+double KMeansHistory<T>::energy() const
+{
+  return entries_[position_].energy;
+}
+
+template <class T>
+const QVector<T>& KMeansHistory<T>::centroids() const
+{
+  return entries_[position_].centroids;
+}
+
+template <class T>
+const QVector<quint32>& KMeansHistory<T>::assignments() const
+{
+  return assignments_;
+}
+
+template <class T>
+qint64 KMeansHistory<T>::memoryUsed() const
+{
+  return memoryUsed_;
+}
+
+template <class T>
+qint64 KMeansHistory<T>::entrySize(const Entry& entry) const
+{
+  return sizeof(Entry) + entry.centroids.size() * sizeof(T) +
+         entry.changes.size() * sizeof(AssignmentChange) +
+         entry.keyframe.size() * sizeof(quint32);
+}
+
+template <class T>
+void KMeansHistory<T>::truncateFuture()
+{
+  if (position_ < 0 || position_ == entries_.size() - 1)
+    return;
+  for (int i = position_ + 1; i < entries_.size(); i++)
+    memoryUsed_ -= entrySize(entries_[i]);
+  entries_.resize(position_ + 1);
+
+  sinceKeyframe_ = 0;
+  for (int i = position_; i >= 0 && entries_[i].keyframe.isEmpty(); i--)
+    sinceKeyframe_++;
+}
+
+// Drops the oldest entries up to the next keyframe at a time, so the oldest
+// entry always carries a keyframe and every remaining state stays reachable.
+template <class T>
+void KMeansHistory<T>::trimToCap()
+{
+  while (memoryUsed_ > memoryCap_ && position_ > 0)
+  {
+    int cut = 1;
+    while (cut < position_ && entries_[cut].keyframe.isEmpty())
+      cut++;
+    if (entries_[cut].keyframe.isEmpty())
+      break;
+    for (int i = 0; i < cut; i++)
+      memoryUsed_ -= entrySize(entries_[i]);
+    entries_.erase(entries_.begin(), entries_.begin() + cut);
+    position_ -= cut;
+  }
+}
+
+// Walks the working assignments from position_ to index. Walking backwards
+// undoes deltas; a full entry in the way, or a keyframe closer than the
+// current position, restarts from the nearest keyframe at or before index.
+template <class T>
+void KMeansHistory<T>::moveTo(int index)
+{
+  bool walkBack = index < position_;
+  for (int i = index + 1; walkBack && i <= position_; i++)
+    if (entries_[i].full)
+      walkBack = false;
+
+  if (walkBack)
+  {
+    for (int i = position_; i > index; i--)
+      for (int c = entries_[i].changes.size() - 1; c >= 0; c--)
+        assignments_[entries_[i].changes[c].point] = entries_[i].changes[c].from;
+    position_ = index;
+    return;
+  }
+
+  int start = index;
+  while (start > 0 && entries_[start].keyframe.isEmpty())
+    start--;
+  if (index < position_ || start > position_)
+  {
+    assignments_ = entries_[start].keyframe;
+    position_ = start;
+  }
+  for (int i = position_ + 1; i <= index; i++)
+    for (const AssignmentChange& change : entries_[i].changes)
+      assignments_[change.point] = change.to;
+  position_ = index;
+}
+
+#endif
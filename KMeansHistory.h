@@ -0,0 +1,65 @@
+#ifndef KMEANSHISTORY_H
+#define KMEANSHISTORY_H
+
+#include <QVector>
+#include "kmeans.h"
+
+// Bounded log of kmeans iterations for undo/redo and scrubbing. Every entry
+// keeps the centroids and energy after its step plus the assignment changes
+// the step made. Full copies of the assignments (keyframes) are only stored
+// every keyframeInterval entries, after steps with a full delta, and for the
+// oldest entry, so the cost of recording a step is the size of its delta.
+template <class T>
+class KMeansHistory
+{
+public:
+  KMeansHistory(qint64 memoryCap = 256 * 1024 * 1024,
+                int keyframeInterval = 64);
+
+  void clear();
+  void record(const KMeansDelta& delta, const QVector<T>& centroids,
+              const QVector<quint32>& assignments, double energy);
+
+  bool isEmpty() const;
+  bool canStepBack() const;
+  bool canStepForward() const;
+  bool stepBack();
+  bool stepForward();
+  bool seek(quint32 iteration);
+
+  quint32 firstIteration() const;
+  quint32 lastIteration() const;
+  quint32 iteration() const;
+  double energy() const;
+  const QVector<T>& centroids() const;
+  const QVector<quint32>& assignments() const;
+  qint64 memoryUsed() const;
+
+private:
+  struct Entry
+  {
+    quint32 iteration;
+    double energy;
+    bool full;
+    QVector<T> centroids;
+    QVector<AssignmentChange> changes;
+    QVector<quint32> keyframe;
+  };
+
+  qint64 memoryCap_;
+  int keyframeInterval_;
+  int sinceKeyframe_;
+  qint64 memoryUsed_;
+  int position_;
+  QVector<Entry> entries_;
+  QVector<quint32> assignments_;
+
+  qint64 entrySize(const Entry& entry) const;
+  void truncateFuture();
+  void trimToCap();
+  void moveTo(int index);
+};
+
+#include "KMeansHistory.cpp"
+
+#endif // KMEANSHISTORY_H
@@ -0,0 +1,155 @@
+#ifndef KMEANSRUNNER_CPP
+#define KMEANSRUNNER_CPP
+
+#include "KMeansRunner.h"
+#include <chrono>
+
+template <class T>
+KMeansRunner<T>::KMeansRunner(kmeans<T>* alg)
+{
+  alg_ = alg;
+  running_ = false;
+  stopRequested_ = false;
+  stepInterval_ = 0;
+  version_ = 0;
+  taken_ = 0;
+  resync_ = true;
+}
+
+// Runs up to steps iterations, or until the engine stops when steps <= 0.
+template <class T>
+void KMeansRunner<T>::start(std::function<double(T, T)> d, int steps)
+{
+  stop();
+  stopRequested_ = false;
+  running_ = true;
+  // The GUI may have drawn something else since the last run
+  resync_ = true;
+  thread_ = std::thread(&KMeansRunner<T>::run, this, d, steps);
+}
+
+template <class T>
+void KMeansRunner<T>::stop()
+{
+  stopRequested_ = true;
+  if (thread_.joinable())
+    thread_.join();
+  running_ = false;
+}
+
+template <class T>
+bool KMeansRunner<T>::isRunning() const
+{
+  return running_;
+}
+
+template <class T>
+void KMeansRunner<T>::setStepInterval(int ms)
+{
+  stepInterval_ = ms;
+}
+
+// The hook runs on the worker thread after every step that advanced the
+// engine, while the engine is still owned by the worker.
+template <class T>
+void KMeansRunner<T>::setAfterStep(std::function<void()> hook)
+{
+  afterStep_ = hook;
+}
+
+// Returns true when a newer snapshot than the last one taken is available.
+template <class T>
+bool KMeansRunner<T>::takeSnapshot()
+{
+  if (!snapshots_.update())
+    return false;
+  taken_ = snapshots_.front().version;
+  return true;
+}
+
+template <class T>
+KMeansSnapshot<T>& KMeansRunner<T>::snapshot()
+{
+  return snapshots_.front();
+}
+
+template <class T>
+void KMeansRunner<T>::run(std::function<double(T, T)> d, int steps)
+{
+  using namespace std::chrono;
+  bool pending = false;
+  for (int i = 0; (steps <= 0 || i < steps) && !stopRequested_; i++)
+  {
+    auto stepStart = steady_clock::now();
+    quint32 iteration = alg_->iteration();
+    pending = true;
+    bool stepped = alg_->step(d);
+    if (afterStep_ && alg_->iteration() != iteration)
+      afterStep_();
+    if (!stepped)
+      break;
+    publish(false, true);
+    pending = false;
+
+    // Throttle to the requested step interval, staying responsive to stop()
+    auto next = stepStart + milliseconds(stepInterval_.load());
+    while (!stopRequested_ && steady_clock::now() < next)
+      std::this_thread::sleep_for(qMin(duration_cast<milliseconds>(
+                                    next - steady_clock::now()),
+                                  milliseconds(5)));
+  }
+  publish(true, pending);
+  running_ = false;
+}
+
+// When the engine state was already published, the final snapshot carries an
+// empty delta so the last step is not applied twice.
+template <class T>
+void KMeansRunner<T>::publish(bool finished, bool withDelta)
+{
+  KMeansSnapshot<T>& s = snapshots_.back();
+  const quint64 previous = version_;
+  s.version = ++version_;
+  s.iteration = alg_->iteration();
+  s.energy = alg_->getEnergy();
+  s.finished = finished;
+  s.stopReason = alg_->stopReason;
+  s.stats = alg_->lastStats();
+  if (withDelta)
+    s.delta = alg_->lastDelta();
+  else
+  {
+    s.delta = KMeansDelta();
+    s.delta.iteration = s.iteration;
+    s.delta.full = false;
+  }
+
+  // Copy into the slot's existing storage instead of sharing the engine's
+  // vectors, so the engine never detaches on its next write
+  const QVector<T>& centroids = alg_->centroids();
+  s.centroids.resize(centroids.size());
+  std::copy(centroids.begin(), centroids.end(), s.centroids.begin());
+
+  // All n assignments only when the GUI can't catch up through the delta. If
+  // it takes the previous snapshot after this check, the copy is just unused.
+  s.hasAssignments = resync_ || s.delta.full || taken_ != previous;
+  resync_ = false;
+  if (s.hasAssignments)
+  {
+    const QVector<quint32>& assignments = alg_->assignments();
+    s.assignments.resize(assignments.size());
+    std::copy(assignments.begin(), assignments.end(), s.assignments.begin());
+  }
+  else
+    s.assignments.clear();
+
+  snapshots_.publish();
+}
+
+template <class T>
+KMeansRunner<T>::~KMeansRunner()
+{
+  stop();
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef KMEANSRUNNER_H
+#define KMEANSRUNNER_H
+
+#include <atomic>
+#include <thread>
+#include <functional>
+#include "kmeans.h"
+#include "TripleBuffer.h"
+
+// Immutable copy of the engine state after a step, read by the GUI. delta
+// describes the step from the snapshot with version - 1. The assignments are
+// only copied when the delta can't be applied on its own: on the first
+// snapshot of a run, for a full delta, or when the GUI has not taken the
+// snapshot before this one.
+template <class T>
+struct KMeansSnapshot
+{
+  quint64 version = 0;
+  quint32 iteration = 0;
+  double energy = 0.0;
+  bool finished = false;
+  QString stopReason;
+  QVector<T> centroids;
+  bool hasAssignments = false;
+  QVector<quint32> assignments;
+  KMeansStats stats;
+  KMeansDelta delta;
+};
+
+// Runs kmeans<T>::step() on a worker thread. After every step the engine
+// state is published through a triple buffer; the GUI picks up the newest
+// snapshot at its own frame rate. The engine must not be touched by any
+// other thread while isRunning() is true.
+template <class T>
+class KMeansRunner
+{
+public:
+  explicit KMeansRunner(kmeans<T>* alg);
+
+  void start(std::function<double(T, T)> d, int steps);
+  void stop();
+  bool isRunning() const;
+  void setStepInterval(int ms);
+  void setAfterStep(std::function<void()> hook);
+
+  bool takeSnapshot();
+  KMeansSnapshot<T>& snapshot();
+
+  ~KMeansRunner();
+
+private:
+  kmeans<T>* alg_;
+  std::thread thread_;
+  std::atomic<bool> running_, stopRequested_;
+  std::atomic<int> stepInterval_;
+  std::function<void()> afterStep_;
+  TripleBuffer<KMeansSnapshot<T>> snapshots_;
+  quint64 version_;
+  std::atomic<quint64> taken_;
+  bool resync_;
+
+  void run(std::function<double(T, T)> d, int steps);
+  void publish(bool finished, bool withDelta);
+};
+
+#include "KMeansRunner.cpp"
+
+#endif // KMEANSRUNNER_H
@@ -15,9 +15,12 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent),
 
   kmeans_alg_ = nullptr;
   kmeans_alg3D_ = nullptr;
+  runner2D_ = nullptr;
+  runner3D_ = nullptr;
   colors_ = nullptr;
+  plotModel_ = new ClusterPlot2D(ui->plot);
   timer_ = new QTimer(this);
-  timer_->callOnTimeout(this, &MainWindow::Step);
+  timer_->callOnTimeout(this, &MainWindow::PresentFrame);
 
   kmeansExecuting_ = false;
   playing_ = false;
@@ -50,7 +53,7 @@ void MainWindow::showEvent(QShowEvent *event)
   ui->centroidShapeComboBox->setCurrentIndex(11);
 
   ui->stopButton->setEnabled(false);
-  ui->backOneButton->setEnabled(false);
+  UpdateHistoryControls();
 }
 
 void MainWindow::SetSignals()
@@ -79,6 +82,10 @@ void MainWindow::SetSignals()
           this, &MainWindow::CentroidShapeChanged);
   connect(ui->backOneButton, &QPushButton::clicked,
           this, &MainWindow::GoBackwardOneStep);
+  connect(ui->forwardOneButton, &QPushButton::clicked,
+          this, &MainWindow::GoForwardOneStep);
+  connect(ui->historySlider, &QSlider::valueChanged,
+          this, &MainWindow::SeekHistory);
   connect(ui->switch2DAction, &QAction::triggered,
           this, &MainWindow::SwitchTo2D);
   connect(ui->switch3DAction, &QAction::triggered,
@@ -89,6 +96,12 @@ void MainWindow::SetSignals()
           this, &MainWindow::Change3DEye);
   connect(controls3DDialog_, &Controls3D::rotateClicked,
           this, &MainWindow::Rotate3D);
+  connect(ui->regionsAction, &QAction::toggled,
+          this, &MainWindow::ShowDecisionRegions);
+  connect(ui->recordTraceAction, &QAction::toggled,
+          this, &MainWindow::RecordTrace);
+  connect(ui->exportTraceAction, &QAction::triggered,
+          this, &MainWindow::ExportTrace);
 }
 
 void MainWindow::PlaySteps()
@@ -97,32 +110,43 @@ void MainWindow::PlaySteps()
   ui->playButton->setEnabled(false);
   ui->stopButton->setEnabled(true);
   ui->resetButton->setEnabled(false);
-  ui->backOneButton->setEnabled(false);
-  timer_->start(ui->playSpeedSpinBox->value());
   playing_ = true;
+  UpdateHistoryControls();
+  Step();
 }
 
 void MainWindow::ChangePlayTimeout(int timeout)
 {
-  timer_->stop();
-  if (playing_)
-    timer_->start(timeout);
+  if (!playing_)
+    return;
+  if (runner2D_ != nullptr)
+    runner2D_->setStepInterval(timeout);
+  if (runner3D_ != nullptr)
+    runner3D_->setStepInterval(timeout);
 }
 
 void MainWindow::StopPlaying()
 {
-  timer_->stop();
   playing_ = false;
+  timer_->stop();
+  if (mode_ == Mode::TwoD && runner2D_ != nullptr)
+    runner2D_->stop();
+  else if (mode_ == Mode::ThreeD && runner3D_ != nullptr)
+    runner3D_->stop();
+  PresentFrame();
+
   ui->playButton->setEnabled(true);
   ui->stepButton->setEnabled(true);
   ui->stopButton->setEnabled(false);
-  ui->backOneButton->setEnabled(true);
   ui->resetButton->setEnabled(true);
+  UpdateHistoryControls();
 }
 
 void MainWindow::EnableControls(bool state)
 {
   ui->nDataSpinBox->setEnabled(state);
+  ui->distributionComboBox->setEnabled(state);
+  ui->seedSpinBox->setEnabled(state);
   ui->xMinSpinBox->setEnabled(state);
   ui->xMaxSpinBox->setEnabled(state);
   ui->yMinSpinBox->setEnabled(state);
@@ -131,6 +155,10 @@ void MainWindow::EnableControls(bool state)
   ui->kSpinBox->setEnabled(state);
   ui->distanceFComboBox->setEnabled(state);
   ui->initComboBox->setEnabled(state);
+  ui->reductionComboBox->setEnabled(state);
+  ui->refineCheckBox->setEnabled(state);
+  ui->coresetSpinBox->setEnabled(state);
+  ui->importAction->setEnabled(state);
 
   if (mode_ == Mode::ThreeD)
   {
@@ -170,19 +198,28 @@ void MainWindow::Import2D()
     QString nText = in.readLine();
     QString dimText = in.readLine();
 
-    if (dimText.toInt() == 2) Parse2D(in);
+    // The worker must be done with the engine before its data changes
+    Reset2D();
+    if (dimText.toInt() == 2)
+    {
+      DatasetPtr dataset = Parse2D(in);
+      if (ui->collapseDuplicatesAction->isChecked())
+        dataset = Deduplicate::Collapse(dataset);
+      SetDataset(dataset);
+    }
 
     file.close();
-    SetGridBounds(minx_, maxx_, miny_, maxy_);
+    if (!dataset_.isNull())
+      SetGridBounds(dataset_->stats(0).min, dataset_->stats(0).max,
+                    dataset_->stats(1).min, dataset_->stats(1).max);
     DefaultPlot2D();
-    Set2DPairVector(xData_, yData_);
 
     if (kmeans_alg_ == nullptr)
-      kmeans_alg_ = new kmeans<Pair2D>(ui->kSpinBox->value(), pairs_);
+      kmeans_alg_ = new kmeans<Pair2D>(ui->kSpinBox->value(), dataset_);
     else
     {
       kmeans_alg_->reset();
-      kmeans_alg_->setData(pairs_);
+      kmeans_alg_->setData(dataset_);
     }
   }
 }
@@ -219,114 +256,123 @@ void MainWindow::Import3D()
     QString nText = in.readLine();
     QString dimText = in.readLine();
 
-    if (dimText.toInt() == 3) Parse3D(in);
+    // The worker must be done with the engine before its data changes
+    Reset3D();
+    if (dimText.toInt() == 3)
+    {
+      DatasetPtr dataset = Parse3D(in);
+      if (ui->collapseDuplicatesAction->isChecked())
+        dataset = Deduplicate::Collapse(dataset);
+      SetDataset(dataset);
+    }
 
     file.close();
     DefaultPlot3D();
-    ui->viewWidget->setPoints(xData_, yData_, zData_);
-    Set3DPairVector(xData_, yData_, zData_);
     if (kmeans_alg3D_ == nullptr)
-      kmeans_alg3D_ = new kmeans<Pair3D>(ui->kSpinBox->value(), pairs3D_);
+      kmeans_alg3D_ = new kmeans<Pair3D>(ui->kSpinBox->value(), dataset_);
     else
     {
       kmeans_alg3D_->reset();
-      kmeans_alg3D_->setData(pairs3D_);
+      kmeans_alg3D_->setData(dataset_);
     }
   }
 }
 
-void MainWindow::Parse2D(QTextStream& in)
+// The columns are parsed into locals and moved into the data set, which
+// then is the only copy of the points. Bounds come from its statistics.
+// Lines are read a chunk at a time and the chunk is split on the thread pool.
+// A value after the coordinates on the first line makes the file weighted,
+// lines without one then weigh 1.
+DatasetPtr MainWindow::Parse2D(QTextStream& in)
 {
-  QString line = in.readLine();
-  QStringList data = line.split(' ');
-
-  xData_.clear();
-  yData_.clear();
-
-  maxx_ = data[0].toDouble();
-  minx_ = data[0].toDouble();
-  xData_.append(minx_);
-
-  maxy_ = data[1].toDouble();
-  miny_ = data[1].toDouble();
-  yData_.append(miny_);
-
-  double x, y;
+  QVector<double> xData, yData, wData;
+  QVector<QString> lines;
+  bool weighted = false;
   while (!in.atEnd())
   {
-    QString line = in.readLine();
-    QStringList data = line.split(' ');
-
-    x = data[0].toDouble();
-    y = data[1].toDouble();
-    xData_.append(x);
-    yData_.append(y);
-
-    if (x > maxx_) maxx_ = x;
-    if (y > maxy_) maxy_ = y;
-    if (x < minx_) minx_ = x;
-    if (y < miny_) miny_ = y;
+    TRACE_SCOPE("Parse2D chunk", "import");
+    lines.clear();
+    for (int i = 0; i < ParseChunkLines && !in.atEnd(); i++)
+      lines.append(in.readLine());
+    if (xData.isEmpty())
+      weighted = !lines[0].split(' ').value(2).isEmpty();
+
+    const int first = xData.size();
+    xData.resize(first + lines.size());
+    yData.resize(first + lines.size());
+    if (weighted)
+      wData.resize(first + lines.size());
+    const QString* text = lines.constData();
+    double* x = xData.data() + first;
+    double* y = yData.data() + first;
+    double* w = weighted ? wData.data() + first : nullptr;
+    parallelFor(lines.size(), ParseGrain, [&](qint64 begin, qint64 end)
+    {
+      for (qint64 i = begin; i < end; i++)
+      {
+        QStringList data = text[i].split(' ');
+        x[i] = data[0].toDouble();
+        y[i] = data[1].toDouble();
+        if (w)
+          w[i] = data.value(2).isEmpty() ? 1.0 : data[2].toDouble();
+      }
+    });
   }
+  return DatasetPtr(new Dataset(std::move(xData), std::move(yData),
+                                QVector<double>(), std::move(wData)));
 }
 
-void MainWindow::Parse3D(QTextStream &in)
+DatasetPtr MainWindow::Parse3D(QTextStream &in)
 {
-  QString line = in.readLine();
-  QStringList data = line.split(' ');
-
-  xData_.clear();
-  yData_.clear();
-  zData_.clear();
-
-  maxx_ = data[0].toDouble();
-  minx_ = data[0].toDouble();
-  xData_.append(minx_);
-
-  maxy_ = data[1].toDouble();
-  miny_ = data[1].toDouble();
-  yData_.append(miny_);
-
-  maxz_ = data[2].toDouble();
-  minz_ = data[2].toDouble();
-  zData_.append(minz_);
-
-  double x, y, z;
+  QVector<double> xData, yData, zData, wData;
+  QVector<QString> lines;
+  bool weighted = false;
   while (!in.atEnd())
   {
-    QString line = in.readLine();
-    QStringList data = line.split(' ');
-
-    x = data[0].toDouble();
-    y = data[1].toDouble();
-    z = data[2].toDouble();
-    xData_.append(x);
-    yData_.append(y);
-    zData_.append(z);
-
-    if (x > maxx_) maxx_ = x;
-    if (y > maxy_) maxy_ = y;
-    if (z > maxz_) maxz_ = z;
-    if (x < minx_) minx_ = x;
-    if (y < miny_) miny_ = y;
-    if (z < minz_) minz_ = z;
+    TRACE_SCOPE("Parse3D chunk", "import");
+    lines.clear();
+    for (int i = 0; i < ParseChunkLines && !in.atEnd(); i++)
+      lines.append(in.readLine());
+    if (xData.isEmpty())
+      weighted = !lines[0].split(' ').value(3).isEmpty();
+
+    const int first = xData.size();
+    xData.resize(first + lines.size());
+    yData.resize(first + lines.size());
+    zData.resize(first + lines.size());
+    if (weighted)
+      wData.resize(first + lines.size());
+    const QString* text = lines.constData();
+    double* x = xData.data() + first;
+    double* y = yData.data() + first;
+    double* z = zData.data() + first;
+    double* w = weighted ? wData.data() + first : nullptr;
+    parallelFor(lines.size(), ParseGrain, [&](qint64 begin, qint64 end)
+    {
+      for (qint64 i = begin; i < end; i++)
+      {
+        QStringList data = text[i].split(' ');
+        x[i] = data[0].toDouble();
+        y[i] = data[1].toDouble();
+        z[i] = data[2].toDouble();
+        if (w)
+          w[i] = data.value(3).isEmpty() ? 1.0 : data[3].toDouble();
+      }
+    });
   }
+  return DatasetPtr(new Dataset(std::move(xData), std::move(yData),
+                                std::move(zData), std::move(wData)));
 }
 
 void MainWindow::DefaultPlot2D()
 {
-  ui->plot->clearGraphs();
-  if (ui->plot->graphCount() == 0)
-    ui->plot->addGraph();
-  QCPGraph* g = ui->plot->graph(0);
-  g->setData(xData_, yData_);
-  g->setLineStyle(QCPGraph::lsNone);
-  g->setScatterStyle(pointStyle_);
-  ui->plot->replot();
+  plotModel_->setStyles(pointStyle_, centroidStyle_);
+  plotModel_->showPoints();
 }
 
 void MainWindow::DefaultPlot3D()
 {
-  ui->viewWidget->setPoints(xData_, yData_, zData_);
+  ui->viewWidget->setPoints(dataset_);
 }
 
 void MainWindow::GenerateData()
@@ -337,17 +383,27 @@ void MainWindow::GenerateData()
     Generate3D();
 }
 
-void MainWindow::Generate2D()
+// Same seed and settings give the same data set
+RandomData::Options MainWindow::GeneratorOptions(int dimensions)
 {
-  std::random_device rd;
-  std::mt19937_64 gen(rd());
-  uDistd xDist(ui->xMinSpinBox->value(), ui->xMaxSpinBox->value());
-  uDistd yDist(ui->yMinSpinBox->value(), ui->yMaxSpinBox->value());
-
-  xData_ = RandomData::Generate(xDist, gen, ui->nDataSpinBox->value());
-  yData_ = RandomData::Generate(yDist, gen, ui->nDataSpinBox->value());
+  RandomData::Options options;
+  options.distribution =
+    RandomData::Distribution(ui->distributionComboBox->currentIndex());
+  options.seed = quint64(ui->seedSpinBox->value());
+  options.count = ui->nDataSpinBox->value();
+  options.dimensions = dimensions;
+  options.min[0] = ui->xMinSpinBox->value();
+  options.max[0] = ui->xMaxSpinBox->value();
+  options.min[1] = ui->yMinSpinBox->value();
+  options.max[1] = ui->yMaxSpinBox->value();
+  options.min[2] = ui->zMinSpinBox->value();
+  options.max[2] = ui->zMaxSpinBox->value();
+  return options;
+}
 
-  Set2DPairVector(xData_, yData_);
+void MainWindow::Generate2D()
+{
+  SetDataset(RandomData::Generate(GeneratorOptions(2)));
 
   SetGridBounds(ui->xMinSpinBox->value(), ui->xMaxSpinBox->value(),
                 ui->yMinSpinBox->value(), ui->yMaxSpinBox->value());
@@ -357,17 +413,7 @@ void MainWindow::Generate2D()
 
 void MainWindow::Generate3D()
 {
-  std::random_device rd;
-  std::mt19937_64 gen(rd());
-  uDistd xDist(ui->xMinSpinBox->value(), ui->xMaxSpinBox->value());
-  uDistd yDist(ui->yMinSpinBox->value(), ui->yMaxSpinBox->value());
-  uDistd zDist(ui->zMinSpinBox->value(), ui->zMaxSpinBox->value());
-
-  xData_ = RandomData::Generate(xDist, gen, ui->nDataSpinBox->value());
-  yData_ = RandomData::Generate(yDist, gen, ui->nDataSpinBox->value());
-  zData_ = RandomData::Generate(zDist, gen, ui->nDataSpinBox->value());
-
-  Set3DPairVector(xData_, yData_, zData_);
+  SetDataset(RandomData::Generate(GeneratorOptions(3)));
 
   DefaultPlot3D();
   Reset3D();
@@ -390,16 +436,19 @@ void MainWindow::Step()
 
 void MainWindow::Step2D()
 {
-  if (pairs_.size() == 0)
+  if (dataset_.isNull() || dataset_->dimensions() != 2 ||
+      dataset_->size() == 0)
   {
     eMsg_->showMessage("Data not initialized. Can't perform kmeans.");
+    if (playing_)
+      StopPlaying();
   }
   else
   {
     bool degenerate = false;
     int k = ui->kSpinBox->value();
     if (kmeans_alg_ == nullptr)
-      kmeans_alg_ = new kmeans<Pair2D>(k, pairs_);
+      kmeans_alg_ = new kmeans<Pair2D>(k, dataset_);
 
     if (!kmeansExecuting_)
     {
@@ -407,27 +456,25 @@ void MainWindow::Step2D()
       if (!degenerate)
       {
         kmeansExecuting_ = true;
+        history2D_.clear();
         kmeans_alg_->reset();
+        kmeans_alg_->setStatsEnabled(true);
         kmeans_alg_->setK(k);
-        kmeans_alg_->setData(pairs_);
+        kmeans_alg_->setData(dataset_);
+        kmeans_alg_->setSeed(quint64(ui->seedSpinBox->value()));
         SetColorVector(k);
+        plotModel_->setStyles(pointStyle_, centroidStyle_);
         if (mode_ == Mode::ThreeD)
-        {
-          QVector<float> colors;
-          for (int i = 0; i < colors_->size(); i++)
-          {
-            colors.append(colors_->at(i).redF());
-            colors.append(colors_->at(i).greenF());
-            colors.append(colors_->at(i).blueF());
-          }
-          ui->viewWidget->setPointColors(colors);
-        }
+          ui->viewWidget->setPalette(*colors_);
         EnableControls(false);
 
         if (ui->initComboBox->currentText() == "Random")
         {
+          const DimensionStats& x = dataset_->stats(0);
+          const DimensionStats& y = dataset_->stats(1);
           QVector<Pair2D> randomCentroids = Pair2D::MakeRandomPairs(k,
-                                FindXMin(), FindXMax(), FindYMin(), FindYMax());
+                                x.min, x.max, y.min, y.max,
+                                quint64(ui->seedSpinBox->value()));
           kmeans_alg_->setInitialization(InitializeType::Random);
           kmeans_alg_->setRandomCentroids(randomCentroids);
         }
@@ -435,57 +482,69 @@ void MainWindow::Step2D()
           kmeans_alg_->setInitialization(InitializeType::Kpp);
         if (ui->initComboBox->currentText() == "Sample")
           kmeans_alg_->setInitialization(InitializeType::Sample);
+
+        if (ui->reductionComboBox->currentText() == "Grid")
+        {
+          const GridAggregate::Result& grid = DatasetGrid();
+          kmeans_alg_->setReduction(grid.cells, grid.cellOf,
+                                    ui->refineCheckBox->isChecked());
+        }
+        else if (ui->reductionComboBox->currentText() == "Coreset")
+          kmeans_alg_->setReduction(DatasetCoreset(), QVector<quint32>(),
+                                    ui->refineCheckBox->isChecked());
+        else
+          kmeans_alg_->setReduction(DatasetPtr());
       }
     }
     if (!degenerate)
     {
       std::function<double(Pair2D, Pair2D)> distF;
       if (ui->distanceFComboBox->currentText() == "L1")
-        distF = Pair2D::L1Distance;
-      else
-        distF = Pair2D::EuclideanDistance;
-
-      if (step_)
-      {
-        CopyLastStep();
-        if (!playing_)
-          ui->backOneButton->setEnabled(true);
-      }
-
-      bool stepSuccessful;
-      int stepValue = ui->stepSpinBox->value();
-      if (stepValue == 1)
-        stepSuccessful = kmeans_alg_->step(distF);
-      else
-        stepSuccessful = kmeans_alg_->step(distF, stepValue);
-      if (!stepSuccessful)
       {
-        infoDialog_->ChangeInfo(step_, kmeans_alg_->getEnergy(),
-                                kmeans_alg_->stopReason);
-        StopPlaying();
+        distF = Pair2D::L1Distance;
+        plotModel_->setMetric(DecisionRegions::L1);
       }
       else
       {
-        step_++;
-        Set2DGraphData();
-        infoDialog_->ChangeInfo(step_, kmeans_alg_->getEnergy());
+        distF = Pair2D::EuclideanDistance;
+        plotModel_->setMetric(DecisionRegions::Euclidean);
       }
+
+      if (runner2D_ == nullptr)
+        runner2D_ = new KMeansRunner<Pair2D>(kmeans_alg_);
+      runner2D_->setAfterStep([this]() { RecordStep(); });
+      runner2D_->setStepInterval(playing_ ? ui->playSpeedSpinBox->value() : 0);
+
+      // Continue from the iteration shown after moving through the history
+      if (!history2D_.isEmpty() && history2D_.iteration() != kmeans_alg_->iteration())
+        kmeans_alg_->restoreState(history2D_.iteration(), history2D_.centroids(),
+                           history2D_.assignments(), history2D_.energy());
+
+      ui->stepButton->setEnabled(false);
+      runner2D_->start(distF, playing_ ? 0 : ui->stepSpinBox->value());
+      timer_->start(FrameIntervalMs);
+      UpdateHistoryControls();
     }
+    else if (playing_)
+      StopPlaying();
   }
 }
 
 void MainWindow::Step3D()
 {
-  if (pairs3D_.size() == 0)
+  if (dataset_.isNull() || dataset_->dimensions() != 3 ||
+      dataset_->size() == 0)
   {
     eMsg_->showMessage("Data not initialized. Can't perform kmeans.");
+    if (playing_)
+      StopPlaying();
   }
   else
   {
     bool degenerate = false;
     int k = ui->kSpinBox->value();
     if (kmeans_alg3D_ == nullptr)
-      kmeans_alg3D_ = new kmeans<Pair3D>(k, pairs3D_);
+      kmeans_alg3D_ = new kmeans<Pair3D>(k, dataset_);
 
     if (!kmeansExecuting_)
     {
@@ -493,27 +552,25 @@ void MainWindow::Step3D()
       if (!degenerate)
       {
         kmeansExecuting_ = true;
+        history3D_.clear();
         kmeans_alg3D_->reset();
-        kmeans_alg3D_->setData(pairs3D_);
+        kmeans_alg3D_->setStatsEnabled(true);
+        kmeans_alg3D_->setData(dataset_);
         kmeans_alg3D_->setK(k);
+        kmeans_alg3D_->setSeed(quint64(ui->seedSpinBox->value()));
         SetColorVector(k);
-
-        QVector<float> colors;
-        for (int i = 0; i < colors_->size(); i++)
-        {
-          colors.append(colors_->at(i).redF());
-          colors.append(colors_->at(i).greenF());
-          colors.append(colors_->at(i).blueF());
-        }
-        ui->viewWidget->setPointColors(colors);
+        ui->viewWidget->setPalette(*colors_);
 
         EnableControls(false);
 
         if (ui->initComboBox->currentText() == "Random")
         {
+          const DimensionStats& x = dataset_->stats(0);
+          const DimensionStats& y = dataset_->stats(1);
+          const DimensionStats& z = dataset_->stats(2);
           QVector<Pair3D> randomCentroids = Pair3D::MakeRandomPairs(k,
-                                FindXMin(), FindXMax(), FindYMin(), FindYMax(),
-                                FindZMin(), FindZMax());
+                                x.min, x.max, y.min, y.max, z.min, z.max,
+                                quint64(ui->seedSpinBox->value()));
           kmeans_alg3D_->setInitialization(InitializeType::Random);
           kmeans_alg3D_->setRandomCentroids(randomCentroids);
         }
@@ -521,6 +578,18 @@ void MainWindow::Step3D()
           kmeans_alg3D_->setInitialization(InitializeType::Kpp);
         if (ui->initComboBox->currentText() == "Sample")
           kmeans_alg3D_->setInitialization(InitializeType::Sample);
+
+        if (ui->reductionComboBox->currentText() == "Grid")
+        {
+          const GridAggregate::Result& grid = DatasetGrid();
+          kmeans_alg3D_->setReduction(grid.cells, grid.cellOf,
+                                      ui->refineCheckBox->isChecked());
+        }
+        else if (ui->reductionComboBox->currentText() == "Coreset")
+          kmeans_alg3D_->setReduction(DatasetCoreset(), QVector<quint32>(),
+                                      ui->refineCheckBox->isChecked());
+        else
+          kmeans_alg3D_->setReduction(DatasetPtr());
       }
     }
     if (!degenerate)
@@ -531,97 +600,184 @@ void MainWindow::Step3D()
       else
         distF = Pair3D::EuclideanDistance;
 
-      if (step_)
-      {
-        CopyLastStep();
-        if (!playing_)
-          ui->backOneButton->setEnabled(true);
-      }
+      if (runner3D_ == nullptr)
+        runner3D_ = new KMeansRunner<Pair3D>(kmeans_alg3D_);
+      runner3D_->setAfterStep([this]() { RecordStep(); });
+      runner3D_->setStepInterval(playing_ ? ui->playSpeedSpinBox->value() : 0);
 
-      bool stepSuccessful;
-      int stepValue = ui->stepSpinBox->value();
-      if (stepValue == 1)
-        stepSuccessful = kmeans_alg3D_->step(distF);
-      else
-        stepSuccessful = kmeans_alg3D_->step(distF, stepValue);
-      if (!stepSuccessful)
-      {
-        infoDialog_->ChangeInfo(step_, kmeans_alg3D_->getEnergy(),
-                                kmeans_alg3D_->stopReason);
-        StopPlaying();
-      }
-      else
-      {
-        step_++;
-        Set3DGraphData();
-        infoDialog_->ChangeInfo(step_, kmeans_alg3D_->getEnergy());
-      }
+      // Continue from the iteration shown after moving through the history
+      if (!history3D_.isEmpty() && history3D_.iteration() != kmeans_alg3D_->iteration())
+        kmeans_alg3D_->restoreState(history3D_.iteration(), history3D_.centroids(),
+                           history3D_.assignments(), history3D_.energy());
+
+      ui->stepButton->setEnabled(false);
+      runner3D_->start(distF, playing_ ? 0 : ui->stepSpinBox->value());
+      timer_->start(FrameIntervalMs);
+      UpdateHistoryControls();
     }
+    else if (playing_)
+      StopPlaying();
   }
 }
 
-void MainWindow::GoBackwardOneStep()
+// Shows the newest snapshot published by the running engine, if any. Called
+// by timer_ once per frame while a run is active.
+void MainWindow::PresentFrame()
+{
+  if (mode_ == Mode::TwoD && runner2D_ != nullptr && runner2D_->takeSnapshot())
+  {
+    KMeansSnapshot<Pair2D>& snapshot = runner2D_->snapshot();
+    step_ = snapshot.iteration;
+    if (snapshot.hasAssignments)
+      Set2DGraphData(snapshot.centroids, snapshot.assignments);
+    else
+      plotModel_->update(snapshot.centroids, snapshot.delta);
+    infoDialog_->ChangeInfo(step_, snapshot.energy, snapshot.stopReason);
+    infoDialog_->ChangeStats(snapshot.stats);
+    if (snapshot.finished)
+      FinishRun();
+  }
+  else if (mode_ == Mode::ThreeD && runner3D_ != nullptr &&
+           runner3D_->takeSnapshot())
+  {
+    KMeansSnapshot<Pair3D>& snapshot = runner3D_->snapshot();
+    step_ = snapshot.iteration;
+    // Without assignments the delta applies on top of the last snapshot
+    if (snapshot.hasAssignments)
+      Set3DGraphData(snapshot.centroids, snapshot.assignments);
+    else
+      Update3DGraphData(snapshot.centroids, snapshot.delta);
+    infoDialog_->ChangeInfo(step_, snapshot.energy, snapshot.stopReason);
+    infoDialog_->ChangeStats(snapshot.stats);
+    if (snapshot.finished)
+      FinishRun();
+  }
+}
+
+void MainWindow::FinishRun()
 {
-  step_--;
-  ui->backOneButton->setEnabled(false);
+  timer_->stop();
   if (mode_ == Mode::TwoD)
+    runner2D_->stop();
+  else if (mode_ == Mode::ThreeD)
+    runner3D_->stop();
+
+  if (playing_)
+    StopPlaying();
+  else
   {
-    PairBuckets assignedPairs = GetPairBuckets(assignmentsBackward_);
+    ui->stepButton->setEnabled(true);
+    UpdateHistoryControls();
+  }
+}
 
-    DrawData(centroidsBackward_, assignedPairs);
-    kmeans_alg_->centroids() = centroidsBackward_;
-    kmeans_alg_->setIgnoreSameAssignments(true);
+// Stops any run and discards snapshots that were not shown yet.
+void MainWindow::StopRunner()
+{
+  timer_->stop();
+  if (runner2D_ != nullptr)
+  {
+    runner2D_->stop();
+    runner2D_->takeSnapshot();
   }
-  if (mode_ == Mode::ThreeD)
+  if (runner3D_ != nullptr)
   {
-    QVector<float> centroidPoints, centroidColors, colors;
-    for (int i = 0; i < assignmentsBackward_.size(); i++)
-    {
-      colors.append(colors_->at(assignmentsBackward_[i]).redF());
-      colors.append(colors_->at(assignmentsBackward_[i]).greenF());
-      colors.append(colors_->at(assignmentsBackward_[i]).blueF());
-    }  for (int i = 0; i < assignmentsBackward_.size(); i++)
-    {
-      colors.append(colors_->at(assignmentsBackward_[i]).redF());
-      colors.append(colors_->at(assignmentsBackward_[i]).greenF());
-      colors.append(colors_->at(assignmentsBackward_[i]).blueF());
-    }
-    ui->viewWidget->setPointColors(colors);
+    runner3D_->stop();
+    runner3D_->takeSnapshot();
+  }
+}
 
-    for (int i = 0; i < centroids3DBackward_.size(); i++)
-    {
-      centroidPoints.append(centroids3DBackward_.at(i)[0]);
-      centroidPoints.append(centroids3DBackward_.at(i)[1]);
-      centroidPoints.append(centroids3DBackward_.at(i)[2]);
+void MainWindow::GoBackwardOneStep()
+{
+  if (mode_ == Mode::TwoD && history2D_.stepBack())
+    ShowHistoryState();
+  else if (mode_ == Mode::ThreeD && history3D_.stepBack())
+    ShowHistoryState();
+}
 
-      centroidColors.append(colors_->at(i).redF());
-      centroidColors.append(colors_->at(i).greenF());
-      centroidColors.append(colors_->at(i).blueF());
-    }
-    ui->viewWidget->setCentroidPoints(centroidPoints);
-    ui->viewWidget->setCentroidColors(centroidColors);
-    kmeans_alg3D_->setIgnoreSameAssignments(true);
+void MainWindow::GoForwardOneStep()
+{
+  if (mode_ == Mode::TwoD && history2D_.stepForward())
+    ShowHistoryState();
+  else if (mode_ == Mode::ThreeD && history3D_.stepForward())
+    ShowHistoryState();
+}
+
+void MainWindow::SeekHistory(int iteration)
+{
+  if (mode_ == Mode::TwoD && history2D_.seek(iteration))
+    ShowHistoryState();
+  else if (mode_ == Mode::ThreeD && history3D_.seek(iteration))
+    ShowHistoryState();
+}
+
+void MainWindow::ShowHistoryState()
+{
+  if (mode_ == Mode::TwoD)
+  {
+    step_ = history2D_.iteration();
+    Set2DGraphData(history2D_.centroids(), history2D_.assignments());
+    infoDialog_->ChangeInfo(step_, history2D_.energy());
+  }
+  else if (mode_ == Mode::ThreeD)
+  {
+    step_ = history3D_.iteration();
+    Set3DGraphData(history3D_.centroids(), history3D_.assignments());
+    infoDialog_->ChangeInfo(step_, history3D_.energy());
   }
-  infoDialog_->ChangeInfo(step_, energyBackward_);
+  UpdateHistoryControls();
 }
 
-void MainWindow::CopyLastStep()
+void MainWindow::UpdateHistoryControls()
 {
-  if (step_)
+  // The worker records into the history while a run is active
+  bool idle = !playing_ &&
+              !(runner2D_ != nullptr && runner2D_->isRunning()) &&
+              !(runner3D_ != nullptr && runner3D_->isRunning());
+  bool back = false, forward = false;
+  int first = 0, last = 0, current = 0;
+  if (!idle)
   {
-    if (mode_ == Mode::TwoD)
-    {
-      centroidsBackward_ = kmeans_alg_->centroids();
-      assignmentsBackward_ = kmeans_alg_->assignments();
-      energyBackward_ = kmeans_alg_->getEnergy();
-    }
-    else if (mode_ == Mode::ThreeD)
-    {
-      centroids3DBackward_ = kmeans_alg3D_->centroids();
-      assignmentsBackward_ = kmeans_alg3D_->assignments();
-      energyBackward_ = kmeans_alg3D_->getEnergy();
-    }
+    ui->backOneButton->setEnabled(false);
+    ui->forwardOneButton->setEnabled(false);
+    ui->historySlider->setEnabled(false);
+    return;
   }
+  if (mode_ == Mode::TwoD && !history2D_.isEmpty())
+  {
+    back = history2D_.canStepBack();
+    forward = history2D_.canStepForward();
+    first = history2D_.firstIteration();
+    last = history2D_.lastIteration();
+    current = history2D_.iteration();
+  }
+  else if (mode_ == Mode::ThreeD && !history3D_.isEmpty())
+  {
+    back = history3D_.canStepBack();
+    forward = history3D_.canStepForward();
+    first = history3D_.firstIteration();
+    last = history3D_.lastIteration();
+    current = history3D_.iteration();
+  }
+
+  ui->backOneButton->setEnabled(back);
+  ui->forwardOneButton->setEnabled(forward);
+  ui->historySlider->setEnabled(last > first);
+  QSignalBlocker blocker(ui->historySlider);
+  ui->historySlider->setRange(first, last);
+  ui->historySlider->setValue(current);
+}
+
+// Runs on the engine's worker thread after each step.
+void MainWindow::RecordStep()
+{
+  if (mode_ == Mode::TwoD)
+    history2D_.record(kmeans_alg_->lastDelta(), kmeans_alg_->centroids(),
+                      kmeans_alg_->assignments(), kmeans_alg_->getEnergy());
+  else if (mode_ == Mode::ThreeD)
+    history3D_.record(kmeans_alg3D_->lastDelta(), kmeans_alg3D_->centroids(),
+                      kmeans_alg3D_->assignments(),
+                      kmeans_alg3D_->getEnergy());
 }
 
 void MainWindow::Reset()
@@ -634,35 +790,40 @@ void MainWindow::Reset()
 
 void MainWindow::Reset2D()
 {
-  timer_->stop();
+  StopRunner();
   DefaultPlot2D();
   kmeansExecuting_ = false;
   playing_ = false;
   EnableControls(true);
   ui->stopButton->setEnabled(false);
-  ui->backOneButton->setEnabled(false);
   infoDialog_->ChangeInfo(0, 0.0);
+  infoDialog_->ClearStats();
   step_ = 0;
+  history2D_.clear();
+  UpdateHistoryControls();
 }
 
 void MainWindow::Reset3D()
 {
-  timer_->stop();
+  StopRunner();
   ui->viewWidget->reset();
   DefaultPlot3D();
   kmeansExecuting_ = false;
   playing_ = false;
   EnableControls(true);
   ui->stopButton->setEnabled(false);
-  ui->backOneButton->setEnabled(false);
   infoDialog_->ChangeInfo(0, 0.0);
+  infoDialog_->ClearStats();
   step_ = 0;
+  history3D_.clear();
+  UpdateHistoryControls();
   ui->viewWidget->setPointSize(ui->pointSizeSpinBox->value());
   ui->plot->hide();
   ui->viewWidget->show();
   ui->viewWidget->setFocus();
   ui->switch2DAction->setEnabled(true);
   ui->switch3DAction->setEnabled(false);
+  ui->regionsAction->setEnabled(false);
 
   ui->zBoundsLabel->setEnabled(true);
   ui->zMinSpinBox->setEnabled(true);
@@ -682,13 +843,10 @@ void MainWindow::PointSizeChanged(int size)
   {
     pointStyle_.setSize(size);
     centroidStyle_.setSize(size + 25);
-    if (!playing_)
-    {
-      if(kmeansExecuting_)
-        Set2DGraphData();
-      else
-        DefaultPlot2D();
-    }
+    if (kmeansExecuting_)
+      plotModel_->setStyles(pointStyle_, centroidStyle_);
+    else if (!playing_)
+      DefaultPlot2D();
   }
   else if (mode_ == Mode::ThreeD)
     ui->viewWidget->setPointSize(size);
@@ -697,114 +855,89 @@ void MainWindow::PointSizeChanged(int size)
 void MainWindow::PointShapeChanged(QString text)
 {
   pointStyle_.setShape(GetStyleFromString(text));
-  if (!playing_)
-  {
-    if(kmeansExecuting_)
-      Set2DGraphData();
-    else
-      DefaultPlot2D();
-  }
+  if (kmeansExecuting_)
+    plotModel_->setStyles(pointStyle_, centroidStyle_);
+  else if (!playing_)
+    DefaultPlot2D();
 }
 
 void MainWindow::CentroidShapeChanged(QString text)
 {
   centroidStyle_.setShape(GetStyleFromString(text));
-  if (!playing_)
-  {
-    if(kmeansExecuting_)
-      Set2DGraphData();
-    else
-      DefaultPlot2D();
-  }
+  if (kmeansExecuting_)
+    plotModel_->setStyles(pointStyle_, centroidStyle_);
+  else if (!playing_)
+    DefaultPlot2D();
 }
 
-void MainWindow::Set2DPairVector(QVector<double> x, QVector<double> y)
+void MainWindow::SetDataset(DatasetPtr dataset)
 {
   ui->stepButton->setEnabled(true);
   ui->resetButton->setEnabled(true);
   ui->playButton->setEnabled(true);
-  pairs_.clear();
-  for (int i = 0; i < x.size(); i++)
-    pairs_.append(Pair2D(x[i], y[i]));
+  dataset_ = dataset;
+  grid_ = GridAggregate::Result();
+  plotModel_->setDataset(dataset_);
 }
 
-void MainWindow::Set3DPairVector(QVector<double> x, QVector<double> y,
-                                 QVector<double> z)
+const GridAggregate::Result& MainWindow::DatasetGrid()
 {
-  ui->stepButton->setEnabled(true);
-  ui->resetButton->setEnabled(true);
-  ui->playButton->setEnabled(true);
-  pairs3D_.clear();
-  for (int i = 0; i < x.size(); i++)
-    pairs3D_.append(Pair3D(x[i], y[i], z[i]));
+  if (grid_.cells.isNull())
+    grid_ = GridAggregate::Build(*dataset_, GridAggregate::Options());
+  return grid_;
 }
 
-void MainWindow::Set2DGraphData()
+DatasetPtr MainWindow::DatasetCoreset()
 {
-  QVector<Pair2D>& centroids = kmeans_alg_->centroids();
-  QVector<quint32>& assignments = kmeans_alg_->assignments();
-  PairBuckets assignedPairs = GetPairBuckets(assignments);
+  Coreset::Options options;
+  options.size = ui->coresetSpinBox->value();
+  options.seed = quint64(ui->seedSpinBox->value());
+  return Coreset::Build(*dataset_, options);
+}
 
-  DrawData(centroids, assignedPairs);
+void MainWindow::Set2DGraphData(const QVector<Pair2D>& centroids,
+                                const QVector<quint32>& assignments)
+{
+  TRACE_SCOPE("Set2DGraphData", "gui");
+  plotModel_->rebuild(centroids, assignments);
 }
 
 void MainWindow::Set3DGraphData()
 {
-  QVector<Pair3D>& centroids = kmeans_alg3D_->centroids();
-  QVector<quint32>& assignments = kmeans_alg3D_->assignments();
-  QVector<float> centroidPoints, centroidColors, colors;
+  if (runner3D_ != nullptr && runner3D_->isRunning())
+    return;
+  Set3DGraphData(kmeans_alg3D_->centroids(), kmeans_alg3D_->assignments());
+}
 
-  for (int i = 0; i < assignments.size(); i++)
-  {
-    colors.append(colors_->at(assignments[i]).redF());
-    colors.append(colors_->at(assignments[i]).greenF());
-    colors.append(colors_->at(assignments[i]).blueF());
-  }
-  ui->viewWidget->setPointColors(colors);
+void MainWindow::Set3DGraphData(const QVector<Pair3D>& centroids,
+                                const QVector<quint32>& assignments)
+{
+  TRACE_SCOPE("Set3DGraphData", "gui");
+  ui->viewWidget->setPointClusters(assignments);
+  Set3DCentroidData(centroids);
+}
 
+// Recolors only the points listed in the delta.
+void MainWindow::Update3DGraphData(const QVector<Pair3D>& centroids,
+                                   const KMeansDelta& delta)
+{
+  TRACE_SCOPE("Update3DGraphData", "gui");
+  for (const AssignmentChange& change : delta.changes)
+    ui->viewWidget->setPointCluster(change.point, change.to);
+  if (!delta.movedCentroids.isEmpty())
+    Set3DCentroidData(centroids);
+}
+
+void MainWindow::Set3DCentroidData(const QVector<Pair3D>& centroids)
+{
+  QVector<float> centroidPoints;
   for (int i = 0; i < centroids.size(); i++)
   {
     centroidPoints.append(centroids.at(i)[0]);
     centroidPoints.append(centroids.at(i)[1]);
     centroidPoints.append(centroids.at(i)[2]);
-
-    centroidColors.append(colors_->at(i).redF());
-    centroidColors.append(colors_->at(i).greenF());
-    centroidColors.append(colors_->at(i).blueF());
   }
   ui->viewWidget->setCentroidPoints(centroidPoints);
-  ui->viewWidget->setCentroidColors(centroidColors);
-}
-
-void MainWindow::DrawData(QVector<Pair2D> &centroids, PairBuckets &assignedPairs)
-{
-  int k = kmeans_alg_->k();
-  QCustomPlot* plot = ui->plot;
-  ui->plot->clearGraphs();
-
-  for (int i = 0; i < k; i++)
-  {
-    plot->addGraph();
-    QCPGraph* g = plot->graph(i);
-    g->setData(assignedPairs[i].first, assignedPairs[i].second);
-    g->setLineStyle(QCPGraph::lsNone);
-    g->setScatterStyle(pointStyle_);
-    g->setPen(QPen(colors_->at(i)));
-  }
-
-  for (int i = 0; i < k; i++)
-  {
-    plot->addGraph();
-    QCPGraph* g = plot->graph(i + k);
-    QVector<double> x, y;
-    x.append(centroids[i][0]);
-    y.append(centroids[i][1]);
-    g->setData(x, y);
-    g->setLineStyle(QCPGraph::lsNone);
-    g->setScatterStyle(centroidStyle_);
-    g->setPen(QPen(colors_->at(i)));
-  }
-  plot->replot();
 }
 
 void MainWindow::SetColorVector(int k)
@@ -816,36 +949,39 @@ void MainWindow::SetColorVector(int k)
 
   for (int i = 0; i < k; i++)
     colors_->append(QColor::fromHsvF(1.0 / double(k) * double(i), 1.0, 1.0));
+  plotModel_->setColors(*colors_);
 }
 
-PairBuckets MainWindow::GetPairBuckets(QVector<quint32> &assignments)
+void MainWindow::ShowInfoDialog()
 {
-  PairBuckets assignedPairs(kmeans_alg_->k());
+  infoDialog_->show();
+}
 
-  for (int i = 0; i < assignments.size(); i++)
-  {
-    assignedPairs[assignments[i]].first.append(xData_[i]);
-    assignedPairs[assignments[i]].second.append(yData_[i]);
-  }
+void MainWindow::ShowDecisionRegions(bool visible)
+{
+  plotModel_->setRegionsVisible(visible);
+}
 
-  return assignedPairs;
+void MainWindow::RecordTrace(bool enabled)
+{
+  Trace::setEnabled(enabled);
 }
 
-void MainWindow::ShowInfoDialog()
+void MainWindow::ExportTrace()
 {
-  infoDialog_->show();
+  QString filename = QFileDialog::getSaveFileName(this, "Export Trace",
+                                                  QDir::home().absolutePath(),
+                                                  tr("*.json"));
+  if (filename.isEmpty())
+    return;
+  if (!Trace::exportChromeJson(filename))
+    eMsg_->showMessage("Unable to write trace file.");
 }
 
 bool MainWindow::CheckDegenerateCases()
 {
   int k = ui->kSpinBox->value();
-  int n;
-  if (mode_ == Mode::TwoD)
-    n = pairs_.size();
-  else if (mode_ == Mode::ThreeD)
-    n = pairs3D_.size();
-  else
-    n = 0;
+  int n = dataset_.isNull() ? 0 : dataset_->size();
 
   if (k == 0 || k == 1)
   {
@@ -886,138 +1022,6 @@ void MainWindow::Change3DEye(QString direction, float amount)
     vw->moveEye(step, 0.0f, 0.0f);
 }
 
-double MainWindow::FindXMin()
-{
-  if (mode_ == Mode::TwoD)
-  {
-    double minX = pairs_[0][0];
-    for (int i = 1; i < pairs_.size(); i++)
-      if (pairs_[i][0] < minX)
-        minX = pairs_[i][0];
-    return minX;
-  }
-  else if (mode_ == Mode::ThreeD)
-  {
-    double minX = pairs3D_[0][0];
-    for (int i = 1; i < pairs3D_.size(); i++)
-      if (pairs3D_[i][0] < minX)
-        minX = pairs3D_[i][0];
-    return minX;
-  }
-  else
-    return 0.0;
-}
-
-double MainWindow::FindXMax()
-{
-  if (mode_ == Mode::TwoD)
-  {
-    double maxX = pairs_[0][0];
-    for (int i = 1; i < pairs_.size(); i++)
-      if (pairs_[i][0] > maxX)
-        maxX = pairs_[i][0];
-    return maxX;
-  }
-  else if (mode_ == Mode::ThreeD)
-  {
-    double maxX = pairs3D_[0][0];
-    for (int i = 1; i < pairs3D_.size(); i++)
-      if (pairs3D_[i][0] > maxX)
-        maxX = pairs3D_[i][0];
-    return maxX;
-  }
-  else
-    return 0.0;
-}
-
-double MainWindow::FindYMin()
-{
-  if (mode_ == Mode::TwoD)
-  {
-    double minY = pairs_[0][1];
-    for (int i = 1; i < pairs_.size(); i++)
-      if (pairs_[i][1] < minY)
-        minY = pairs_[i][1];
-    return minY;
-  }
-  else if (mode_ == Mode::ThreeD)
-  {
-    double minY = pairs3D_[0][1];
-    for (int i = 1; i < pairs3D_.size(); i++)
-      if (pairs3D_[i][1] < minY)
-        minY = pairs3D_[i][1];
-    return minY;
-  }
-  else
-    return 0.0;
-}
-
-double MainWindow::FindYMax()
-{
-  if (mode_ == Mode::TwoD)
-  {
-    double maxY = pairs_[0][1];
-    for (int i = 1; i < pairs_.size(); i++)
-      if (pairs_[i][1] > maxY)
-        maxY = pairs_[i][1];
-    return maxY;
-  }
-  else if (mode_ == Mode::ThreeD)
-  {
-    double maxY = pairs3D_[0][1];
-    for (int i = 1; i < pairs3D_.size(); i++)
-      if (pairs3D_[i][1] > maxY)
-        maxY = pairs3D_[i][1];
-    return maxY;
-  }
-  else
-    return 0.0;
-}
-
-double MainWindow::FindZMin()
-{
-  if (mode_ == Mode::TwoD)
-  {
-    double minZ = pairs_[0][2];
-    for (int i = 1; i < pairs_.size(); i++)
-      if (pairs_[i][2] < minZ)
-        minZ = pairs_[i][2];
-    return minZ;
-  }
-  else if (mode_ == Mode::ThreeD)
-  {
-    double minZ = pairs3D_[0][2];
-    for (int i = 1; i < pairs3D_.size(); i++)
-      if (pairs3D_[i][2] < minZ)
-        minZ = pairs3D_[i][2];
-    return minZ;
-  }
-  else
-    return 0.0;
-}
-
-double MainWindow::FindZMax()
-{
-  if (mode_ == Mode::TwoD)
-  {
-    double maxZ = pairs_[0][2];
-    for (int i = 1; i < pairs_.size(); i++)
-      if (pairs_[i][2] > maxZ)
-        maxZ = pairs_[i][2];
-    return maxZ;
-  }
-  else if (mode_ == Mode::ThreeD)
-  {
-    double maxZ = pairs3D_[0][2];
-    for (int i = 1; i < pairs3D_.size(); i++)
-      if (pairs3D_[i][2] > maxZ)
-        maxZ = pairs3D_[i][2];
-    return maxZ;
-  }
-  else
-    return 0.0;
-}
-
 QCPScatterStyle::ScatterShape MainWindow::GetStyleFromString(QString text)
 {
   text = text.trimmed();
@@ -1059,29 +1063,37 @@ QCPScatterStyle::ScatterShape MainWindow::GetStyleFromString(QString text)
 
 MainWindow::~MainWindow()
 {
+  delete runner2D_;
+  delete runner3D_;
   delete ui;
   delete rndG_;
   delete eMsg_;
   delete kmeans_alg_;
   delete colors_;
+  delete plotModel_;
   delete infoDialog_;
   delete controls3DDialog_;
 }
 
 void MainWindow::SwitchTo2D()
 {
-  xData_.clear();
-  yData_.clear();
-  zData_.clear();
+  dataset_.reset();
+  plotModel_->setDataset(dataset_);
   ui->stepButton->setEnabled(false);
   ui->resetButton->setEnabled(false);
   ui->playButton->setEnabled(false);
   Reset();
+  // Nothing may keep the previous data set alive
+  if (kmeans_alg_ != nullptr)
+    kmeans_alg_->setData(dataset_);
+  if (kmeans_alg3D_ != nullptr)
+    kmeans_alg3D_->setData(dataset_);
   mode_ = Mode::TwoD;
   ui->viewWidget->hide();
   ui->plot->show();
   ui->switch2DAction->setEnabled(false);
   ui->switch3DAction->setEnabled(true);
+  ui->regionsAction->setEnabled(true);
 
   ui->zBoundsLabel->setEnabled(false);
   ui->zMinSpinBox->setEnabled(false);
@@ -1091,6 +1103,8 @@ void MainWindow::SwitchTo2D()
   ui->yMinSpinBox->setEnabled(true);
   ui->yMaxSpinBox->setEnabled(true);
   ui->nDataSpinBox->setEnabled(true);
+  ui->distributionComboBox->setEnabled(true);
+  ui->seedSpinBox->setEnabled(true);
   ui->createDataButton->setEnabled(true);
   ui->kSpinBox->setEnabled(true);
   ui->initComboBox->setEnabled(true);
@@ -1101,19 +1115,24 @@ void MainWindow::SwitchTo2D()
 
 void MainWindow::SwitchTo3D()
 {
-  xData_.clear();
-  yData_.clear();
-  zData_.clear();
+  dataset_.reset();
+  plotModel_->setDataset(dataset_);
   ui->stepButton->setEnabled(false);
   ui->resetButton->setEnabled(false);
   ui->playButton->setEnabled(false);
   Reset();
+  // Nothing may keep the previous data set alive
+  if (kmeans_alg_ != nullptr)
+    kmeans_alg_->setData(dataset_);
+  if (kmeans_alg3D_ != nullptr)
+    kmeans_alg3D_->setData(dataset_);
   mode_ = Mode::ThreeD;
   ui->plot->hide();
   ui->viewWidget->show();
   ui->viewWidget->setFocus();
   ui->switch2DAction->setEnabled(true);
   ui->switch3DAction->setEnabled(false);
+  ui->regionsAction->setEnabled(false);
 
   ui->zBoundsLabel->setEnabled(true);
   ui->zMinSpinBox->setEnabled(true);
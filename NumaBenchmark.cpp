@@ -0,0 +1,74 @@
+#include "NumaBenchmark.h"
+#include "Benchmark.h"
+#include "Pair.h"
+#include "RandomData.h"
+#include "ThreadPool.h"
+#include "kmeans.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <QFile>
+#include <QDebug>
+
+int NumaBenchmark::run(const Options& options)
+{
+  QFile file;
+  if (options.output.isEmpty())
+    file.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+  else
+  {
+    file.setFileName(options.output);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+      qCritical() << "Could not write" << options.output;
+      return 1;
+    }
+  }
+  BenchmarkWriter writer(&file);
+
+  QVector<int> threads = options.threads;
+  if (threads.isEmpty())
+  {
+    const int cores = QThread::idealThreadCount();
+    for (int t = 1; t < cores; t *= 2)
+      threads.push_back(t);
+    threads.push_back(cores);
+  }
+  qInfo() << "Memory nodes:" << ThreadPool::instance().nodeCount();
+  qInfo() << "Pinned threads:" << options.pinThreads;
+
+  QElapsedTimer timer;
+  for (qint64 n : options.sizes)
+  {
+    for (bool numa : {false, true})
+    {
+      for (int t : threads)
+      {
+        // The data set is placed when it is created, under this pool
+        ThreadPool::configure(t, options.pinThreads, numa);
+        RandomData::Options data;
+        data.distribution = RandomData::Blobs;
+        data.seed = 42;
+        data.count = qint32(n);
+        data.clusters = options.k;
+        DatasetPtr dataset = RandomData::Generate(data);
+
+        kmeans<Pair2D> engine(options.k, dataset);
+        engine.setSeed(42);
+        QVector<double> steps;
+        for (int r = 0; r < options.repeats; r++)
+        {
+          // The first step initializes, the second one is a plain step
+          engine.reset();
+          engine.step(Pair2D::EuclideanDistance);
+          timer.start();
+          engine.step(Pair2D::EuclideanDistance);
+          steps.push_back(timer.nsecsElapsed() / 1.0e6);
+        }
+        writer.row("numa", n, options.k, t,
+                   numa ? "step_placed" : "step_unplaced", medianMs(steps));
+      }
+    }
+  }
+  ThreadPool::configure(0);
+  return 0;
+}
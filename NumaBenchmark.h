@@ -0,0 +1,31 @@
+#ifndef NUMABENCHMARK_H
+#define NUMABENCHMARK_H
+
+#include <QVector>
+#include <QString>
+
+// Times k-means steps with the data set left where the allocating thread put
+// it and with NUMA placement (ThreadPool::configure()), from one thread up to
+// all cores, so scaling across sockets shows up. Rows go out in the
+// Benchmark.h CSV format.
+class NumaBenchmark
+{
+public:
+  struct Options
+  {
+    QVector<qint64> sizes = {10000000};
+    int k = 16;
+    int repeats = 5;
+    // Empty doubles from 1 up to all cores
+    QVector<int> threads;
+    // Pins pool threads in both phases (--pin-threads)
+    bool pinThreads = false;
+    // Empty writes to stdout
+    QString output;
+  };
+
+  // Returns the process exit code
+  static int run(const Options& options);
+};
+
+#endif // NUMABENCHMARK_H
@@ -0,0 +1,198 @@
+#ifndef PAIR_H
+#define PAIR_H
+
+#include <QPair>
+#include <QVector>
+#include <QVector3D>
+#include <QtMath>
+#include <RandomData.h>
+
+typedef QPair<double, double> QPair_d;
+
+struct Pair2D
+{
+  QPair_d pair_;
+
+  Pair2D() {}
+  Pair2D(double x, double y) { pair_ = QPair_d(x, y); }
+
+  // Point i of a data set, see Dataset::columnData()
+  static Pair2D FromColumns(const double* const* columns, qint32 i)
+  {
+    return Pair2D(columns[0][i], columns[1][i]);
+  }
+
+  double operator[](int i) const
+  {
+    // There is no third coordinate to alias, see Pair3D for z
+    Q_ASSERT(i == 0 || i == 1);
+    return i == 0 ? pair_.first : pair_.second;
+  }
+
+  Pair2D operator+(const Pair2D& rhs)
+  {
+    Pair2D sum(pair_.first + rhs[0], pair_.second + rhs[1]);
+    return sum;
+  }
+
+  Pair2D& operator+=(const Pair2D& rhs)
+  {
+    pair_.first += rhs[0];
+    pair_.second += rhs[1];
+    return *this;
+  }
+
+  Pair2D& operator-=(const Pair2D& rhs)
+  {
+    pair_.first -= rhs[0];
+    pair_.second -= rhs[1];
+    return *this;
+  }
+
+  Pair2D operator/(const quint32& scalar)
+  {
+    Pair2D quotient(pair_.first / scalar, pair_.second / scalar);
+    return quotient;
+  }
+
+  Pair2D operator/(const double& scalar)
+  {
+    Pair2D quotient(pair_.first / scalar, pair_.second / scalar);
+    return quotient;
+  }
+
+  Pair2D operator*(const double& scalar) const
+  {
+    Pair2D product(pair_.first * scalar, pair_.second * scalar);
+    return product;
+  }
+
+  static double EuclideanDistance(Pair2D lhs, Pair2D rhs)
+  {
+    return qSqrt(qPow(lhs[0] - rhs[0], 2) + qPow(lhs[1] - rhs[1], 2));
+  }
+
+  static double L1Distance(Pair2D lhs, Pair2D rhs)
+  {
+    return qAbs(lhs[0] - rhs[0]) + qAbs(lhs[1] - rhs[1]);
+  }
+
+  // Uniform in the bounds, reproducible for a seed
+  static QVector<Pair2D> MakeRandomPairs(int size, double minX, double maxX,
+                                         double minY, double maxY,
+                                         quint64 seed)
+  {
+    RandomData::Options options;
+    options.seed = seed;
+    options.stream = RandomData::CentroidStream;
+    options.count = size;
+    options.min[0] = minX;
+    options.max[0] = maxX;
+    options.min[1] = minY;
+    options.max[1] = maxY;
+    DatasetPtr data = RandomData::Generate(options);
+
+    QVector<Pair2D> pairs;
+    for (int i = 0; i < size; i++)
+      pairs.append(FromColumns(data->columnData(), i));
+
+    return pairs;
+  }
+};
+
+struct Pair3D
+{
+  QVector3D pair_;
+
+  Pair3D() {}
+  Pair3D(double x, double y, double z) { pair_ = QVector3D(x, y, z); }
+
+  static Pair3D FromColumns(const double* const* columns, qint32 i)
+  {
+    return Pair3D(columns[0][i], columns[1][i], columns[2][i]);
+  }
+
+  double operator[](int i) const
+  {
+    return pair_[i];
+  }
+
+  Pair3D operator+(const Pair3D& rhs)
+  {
+    Pair3D sum(pair_[0] + rhs[0], pair_[1] + rhs[1], pair_[2] + rhs[2]);
+    return sum;
+  }
+
+  Pair3D& operator+=(const Pair3D& rhs)
+  {
+    pair_[0] += rhs[0];
+    pair_[1] += rhs[1];
+    pair_[2] += rhs[2];
+    return *this;
+  }
+
+  Pair3D& operator-=(const Pair3D& rhs)
+  {
+    pair_[0] -= rhs[0];
+    pair_[1] -= rhs[1];
+    pair_[2] -= rhs[2];
+    return *this;
+  }
+
+  Pair3D operator/(const quint32& scalar)
+  {
+    Pair3D quotient(pair_[0] / scalar, pair_[1] / scalar, pair_[2] / scalar);
+    return quotient;
+  }
+
+  Pair3D operator/(const double& scalar)
+  {
+    Pair3D quotient(pair_[0] / scalar, pair_[1] / scalar, pair_[2] / scalar);
+    return quotient;
+  }
+
+  Pair3D operator*(const double& scalar) const
+  {
+    Pair3D product(pair_[0] * scalar, pair_[1] * scalar, pair_[2] * scalar);
+    return product;
+  }
+
+  static double EuclideanDistance(Pair3D lhs, Pair3D rhs)
+  {
+    return qSqrt(qPow(lhs[0] - rhs[0], 2) + qPow(lhs[1] - rhs[1], 2) +
+                 qPow(lhs[2] - rhs[2], 2));
+  }
+
+  static double L1Distance(Pair3D lhs, Pair3D rhs)
+  {
+    return qAbs(lhs[0] - rhs[0]) + qAbs(lhs[1] - rhs[1]) +
+           qAbs(lhs[2] - rhs[2]);
+  }
+
+  static QVector<Pair3D> MakeRandomPairs(int size, double minX, double maxX,
+                                         double minY, double maxY,
+                                         double minZ, double maxZ,
+                                         quint64 seed)
+  {
+    RandomData::Options options;
+    options.seed = seed;
+    options.stream = RandomData::CentroidStream;
+    options.count = size;
+    options.dimensions = 3;
+    options.min[0] = minX;
+    options.max[0] = maxX;
+    options.min[1] = minY;
+    options.max[1] = maxY;
+    options.min[2] = minZ;
+    options.max[2] = maxZ;
+    DatasetPtr data = RandomData::Generate(options);
+
+    QVector<Pair3D> pairs;
+    for (int i = 0; i < size; i++)
+      pairs.append(FromColumns(data->columnData(), i));
+
+    return pairs;
+  }
+};
+
+#endif // PAIR_H
@@ -0,0 +1,110 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <vector>
+#include "ThreadPool.h"
+
+// Number of contiguous chunks parallelChunks() splits n items into.
+inline int parallelChunkCount(qint64 n, qint64 minChunk, int maxChunks = 0)
+{
+  int threads = ThreadPool::instance().threadCount();
+  if (maxChunks > 0)
+    threads = qMin(threads, maxChunks);
+  return int(qBound<qint64>(1, n / qMax<qint64>(1, minChunk), qMax(1, threads)));
+}
+
+// Splits [0, n) into parallelChunkCount() contiguous chunks and runs
+// f(chunk, begin, end) for each of them on the shared thread pool.
+template <class F>
+int parallelChunks(qint64 n, qint64 minChunk, F f, int maxChunks = 0,
+                   ThreadPool::Priority priority = ThreadPool::Normal)
+{
+  int chunks = parallelChunkCount(n, minChunk, maxChunks);
+  if (chunks == 1)
+  {
+    f(0, 0, n);
+    return 1;
+  }
+  ThreadPool::instance().run(chunks, [&f, chunks, n](int c)
+                             { f(c, n * c / chunks, n * (c + 1) / chunks); },
+                             priority);
+  return chunks;
+}
+
+// Runs f(begin, end) over [0, n) in blocks of grain items, one task per
+// block, so idle threads steal blocks and balance the load. With maxThreads
+// set that many tasks take blocks in turn instead. Returns the number of
+// threads that could take part.
+template <class F>
+int parallelFor(qint64 n, qint64 grain, F f, int maxThreads = 0,
+                ThreadPool::Priority priority = ThreadPool::Normal)
+{
+  grain = qMax<qint64>(1, grain);
+  const qint64 blocks = (n + grain - 1) / grain;
+  int threads = ThreadPool::instance().threadCount();
+  if (maxThreads > 0)
+    threads = qMin(threads, maxThreads);
+  if (blocks <= 1 || threads == 1)
+  {
+    if (n > 0)
+      f(0, n);
+    return 1;
+  }
+  if (maxThreads <= 0 || blocks <= threads)
+  {
+    ThreadPool::instance().run(int(blocks), [&f, grain, n](int b)
+                               { f(b * grain, qMin(n, (b + 1) * grain)); },
+                               priority);
+    return int(qMin<qint64>(blocks, threads));
+  }
+  std::atomic<qint64> next(0);
+  ThreadPool::instance().run(threads, [&f, &next, grain, n, blocks](int)
+  {
+    for (qint64 b = next++; b < blocks; b = next++)
+      f(b * grain, qMin(n, (b + 1) * grain));
+  }, priority);
+  return threads;
+}
+
+// Runs f(begin, end) over [0, n) in blocks of grain items like parallelFor(),
+// but with NUMA placement block b always runs on worker b * workers / blocks.
+// Memory first touched this way is read by the same node later, as long as
+// both loops split the same range into the same share per worker.
+template <class F>
+int parallelHome(qint64 n, qint64 grain, F f)
+{
+  ThreadPool& pool = ThreadPool::instance();
+  if (!pool.numaAware() || pool.workerCount() == 0)
+    return parallelFor(n, grain, f);
+  grain = qMax<qint64>(1, grain);
+  const qint64 blocks = (n + grain - 1) / grain;
+  const int workers = pool.workerCount();
+  pool.runOn(int(blocks), [blocks, workers](int b)
+             { return int(b * qint64(workers) / blocks); },
+             [&f, grain, n](int b) { f(b * grain, qMin(n, (b + 1) * grain)); });
+  return int(qMin<qint64>(blocks, workers));
+}
+
+// Maps blocks of grain items to partial results and combines them in block
+// order, so the result depends on n and grain but not on the threads.
+template <class T, class Map, class Combine>
+T parallelReduce(qint64 n, qint64 grain, T identity, Map map, Combine combine,
+                 ThreadPool::Priority priority = ThreadPool::Normal)
+{
+  grain = qMax<qint64>(1, grain);
+  const qint64 blocks = (n + grain - 1) / grain;
+  std::vector<T> partials(size_t(blocks), identity);
+  parallelFor(blocks, 1, [&](qint64 first, qint64 last)
+  {
+    for (qint64 b = first; b < last; b++)
+      partials[size_t(b)] = map(b * grain, qMin(n, (b + 1) * grain));
+  }, 0, priority);
+  T result = identity;
+  for (const T& partial : partials)
+    result = combine(result, partial);
+  return result;
+}
+
+#endif // PARALLEL_H
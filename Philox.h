@@ -0,0 +1,89 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <QtGlobal>
+#include <QtMath>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel Random
+// Numbers: As Easy as 1, 2, 3"). A block of four words is a pure function of
+// a 128 bit counter and a 64 bit key, so any draw can be computed directly
+// from its position instead of by advancing a shared state.
+class Philox4x32
+{
+public:
+  struct Block
+  {
+    quint32 v[4];
+  };
+
+  static Block generate(Block counter, quint64 key)
+  {
+    quint32 k0 = quint32(key);
+    quint32 k1 = quint32(key >> 32);
+    for (int round = 0; round < 10; round++)
+    {
+      if (round > 0)
+      {
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+      }
+      const quint64 p0 = quint64(0xD2511F53) * counter.v[0];
+      const quint64 p1 = quint64(0xCD9E8D57) * counter.v[2];
+      counter = {{quint32(p1 >> 32) ^ counter.v[1] ^ k0, quint32(p1),
+                  quint32(p0 >> 32) ^ counter.v[3] ^ k1, quint32(p0)}};
+    }
+    return counter;
+  }
+
+  // Uniform in [0, 1) from 53 bits of two words
+  static double toUnit(quint32 hi, quint32 lo)
+  {
+    return double(quint64(hi) << 21 | lo >> 11) * (1.0 / 9007199254740992.0);
+  }
+};
+
+// The sequence of uniform draws that belongs to one (seed, stream, index),
+// two per generated block. Index is usually a point, stream keeps different
+// uses of the same seed independent.
+class PhiloxDraws
+{
+public:
+  PhiloxDraws(quint64 seed, quint32 stream, quint64 index) :
+    seed_(seed), stream_(stream), index_(index), block_(0), used_(4) {}
+
+  double uniform()
+  {
+    if (used_ == 4)
+    {
+      words_ = Philox4x32::generate({{quint32(index_), quint32(index_ >> 32),
+                                      block_++, stream_}}, seed_);
+      used_ = 0;
+    }
+    used_ += 2;
+    return Philox4x32::toUnit(words_.v[used_ - 2], words_.v[used_ - 1]);
+  }
+
+  double uniform(double min, double max)
+  {
+    return min + (max - min) * uniform();
+  }
+
+  // Two independent standard normals (Box-Muller)
+  void normals(double& a, double& b)
+  {
+    const double r = qSqrt(-2.0 * qLn(1.0 - uniform()));
+    const double theta = 2.0 * M_PI * uniform();
+    a = r * qCos(theta);
+    b = r * qSin(theta);
+  }
+
+private:
+  quint64 seed_;
+  quint32 stream_;
+  quint64 index_;
+  quint32 block_;
+  int used_;
+  Philox4x32::Block words_;
+};
+
+#endif // PHILOX_H
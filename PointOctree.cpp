@@ -0,0 +1,253 @@
+#include "PointOctree.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <QVector4D>
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+namespace
+{
+const qint64 BuildChunk = 1 << 16;
+
+// Spreads the low 10 bits of v to every third bit
+quint32 spreadBits(quint32 v)
+{
+  v &= 0x3FF;
+  v = (v | (v << 16)) & 0x030000FF;
+  v = (v | (v << 8)) & 0x0300F00F;
+  v = (v | (v << 4)) & 0x030C30C3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+
+quint32 quantize(float v, float min, float scale)
+{
+  return quint32(qBound(0.0f, (v - min) * scale, 1023.0f));
+}
+}
+
+void PointOctree::clear()
+{
+  nodes_.clear();
+  order_.clear();
+  slots_.clear();
+}
+
+// Reads the x, y and z columns of the data set in place
+void PointOctree::build(const Dataset& points)
+{
+  TRACE_SCOPE("PointOctree::build", "render");
+  clear();
+  const qint64 n = points.dimensions() == 3 ? points.size() : 0;
+  if (n == 0)
+    return;
+  const double* const* xyz = points.columnData();
+
+  // Bounds come with the data set
+  QVector3D min, max;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    min[axis] = points.stats(axis).min;
+    max[axis] = points.stats(axis).max;
+  }
+  // A cube keeps the octants cubic, the margin keeps the maximum inside
+  float extent = qMax(1e-6f, qMax(max.x() - min.x(),
+                                  qMax(max.y() - min.y(), max.z() - min.z())));
+  extent *= 1.0001f;
+  max = min + QVector3D(extent, extent, extent);
+
+  // Morton code in the high word, point index in the low word
+  QVector<quint64> sortKeys;
+  sortKeys.resize(int(n));
+  quint64* keys = sortKeys.data();
+  const float scale = 1024.0f / extent;
+  parallelChunks(n, BuildChunk, [&](int, qint64 begin, qint64 end)
+  {
+    for (qint64 i = begin; i < end; i++)
+    {
+      quint32 code = spreadBits(quantize(xyz[0][i], min.x(), scale)) |
+                     spreadBits(quantize(xyz[1][i], min.y(), scale)) << 1 |
+                     spreadBits(quantize(xyz[2][i], min.z(), scale)) << 2;
+      keys[i] = quint64(code) << 32 | quint64(i);
+    }
+  }, 0, ThreadPool::Low);
+
+  // Sort the chunks in parallel, then merge neighbours pairwise
+  const int chunks = parallelChunkCount(n, BuildChunk);
+  QVector<qint64> bounds(chunks + 1);
+  for (int c = 0; c <= chunks; c++)
+    bounds[c] = n * c / chunks;
+  parallelChunks(n, BuildChunk, [&](int, qint64 begin, qint64 end)
+  {
+    std::sort(keys + begin, keys + end);
+  }, 0, ThreadPool::Low);
+  for (int width = 1; width < chunks; width *= 2)
+    for (int c = 0; c + width < chunks; c += 2 * width)
+      std::inplace_merge(keys + bounds[c], keys + bounds[c + width],
+                         keys + bounds[qMin(c + 2 * width, chunks)]);
+
+  order_.resize(int(n));
+  quint32* order = order_.data();
+  parallelChunks(n, BuildChunk, [&](int, qint64 begin, qint64 end)
+  {
+    for (qint64 i = begin; i < end; i++)
+      order[i] = quint32(keys[i]);
+  }, 0, ThreadPool::Low);
+
+  buildNode(sortKeys, 0, int(n), min, max, 0);
+
+  // Shuffling each leaf makes its prefixes uniform samples. Seeding by the
+  // leaf start keeps the layout the same from run to run.
+  QVector<int> leaves;
+  for (int i = 0; i < nodes_.size(); i++)
+    if (nodes_[i].leaf)
+      leaves.append(i);
+  const Node* nodes = nodes_.constData();
+  const int* leafNodes = leaves.constData();
+  parallelChunks(leaves.size(), 16, [&](int, qint64 begin, qint64 end)
+  {
+    for (qint64 l = begin; l < end; l++)
+    {
+      const Node& leaf = nodes[leafNodes[l]];
+      std::mt19937 gen(quint32(leaf.first));
+      std::shuffle(order + leaf.first, order + leaf.first + leaf.count, gen);
+    }
+  }, 0, ThreadPool::Low);
+
+  slots_.resize(int(n));
+  quint32* slots = slots_.data();
+  parallelChunks(n, BuildChunk, [&](int, qint64 begin, qint64 end)
+  {
+    for (qint64 s = begin; s < end; s++)
+      slots[order[s]] = quint32(s);
+  }, 0, ThreadPool::Low);
+}
+
+int PointOctree::buildNode(const QVector<quint64>& keys, int first, int count,
+                           const QVector3D& min, const QVector3D& max,
+                           int depth)
+{
+  int index = nodes_.size();
+  Node node;
+  node.min = min;
+  node.max = max;
+  node.first = first;
+  node.count = count;
+  node.leaf = count <= LeafSize || depth >= MaxDepth;
+  nodes_.append(node);
+  if (node.leaf)
+    return index;
+
+  // Keys of a node share their upper bits, so the octant at this depth
+  // increases through the range
+  const int shift = 32 + 3 * (MaxDepth - 1 - depth);
+  const QVector3D center = (min + max) / 2;
+  const quint64* begin = keys.constData() + first;
+  const quint64* end = keys.constData() + first + count;
+  for (int c = 0; c < 8; c++)
+  {
+    const quint64* split = std::partition_point(begin, end, [&](quint64 key)
+                                                { return int((key >> shift) & 7) <= c; });
+    if (split != begin)
+    {
+      QVector3D childMin(c & 1 ? center.x() : min.x(),
+                         c & 2 ? center.y() : min.y(),
+                         c & 4 ? center.z() : min.z());
+      QVector3D childMax(c & 1 ? max.x() : center.x(),
+                         c & 2 ? max.y() : center.y(),
+                         c & 4 ? max.z() : center.z());
+      int child = buildNode(keys, int(begin - keys.constData()),
+                            int(split - begin), childMin, childMax, depth + 1);
+      nodes_[index].children[c] = child;
+    }
+    begin = split;
+  }
+  return index;
+}
+
+// Collects the ranges of reordered points to draw: leaves outside the view
+// frustum are skipped, and if the visible ones hold more than the budget
+// each gets a share weighted by count / distance^2. Returns the number of
+// visible points, so callers can tell whether everything was drawn.
+qint64 PointOctree::select(const QMatrix4x4& projection,
+                           const QMatrix4x4& modelView, qint64 budget,
+                           QVector<QPair<int, int>>& ranges) const
+{
+  TRACE_SCOPE("PointOctree::select", "render");
+  ranges.clear();
+  if (nodes_.isEmpty())
+    return 0;
+
+  const QMatrix4x4 pmv = projection * modelView;
+  const QVector4D planes[6] = {pmv.row(3) + pmv.row(0), pmv.row(3) - pmv.row(0),
+                               pmv.row(3) + pmv.row(1), pmv.row(3) - pmv.row(1),
+                               pmv.row(3) + pmv.row(2), pmv.row(3) - pmv.row(2)};
+  const QVector3D eye = modelView.inverted().map(QVector3D(0, 0, 0));
+
+  QVector<int> visible;
+  QVector<float> distances;
+  qint64 total = 0;
+  float nearest = -1;
+  QVector<int> stack;
+  stack.append(0);
+  while (!stack.isEmpty())
+  {
+    const Node& node = nodes_[stack.takeLast()];
+    bool outside = false;
+    for (const QVector4D& p : planes)
+    {
+      // The box corner furthest along the plane normal
+      QVector3D corner(p.x() > 0 ? node.max.x() : node.min.x(),
+                       p.y() > 0 ? node.max.y() : node.min.y(),
+                       p.z() > 0 ? node.max.z() : node.min.z());
+      if (QVector3D::dotProduct(p.toVector3D(), corner) + p.w() < 0)
+      {
+        outside = true;
+        break;
+      }
+    }
+    if (outside)
+      continue;
+
+    if (!node.leaf)
+    {
+      // Pushed in reverse so leaves come out in slot order
+      for (int c = 7; c >= 0; c--)
+        if (node.children[c] >= 0)
+          stack.append(node.children[c]);
+      continue;
+    }
+    float distance = qMax(1e-3f, (eye - (node.min + node.max) / 2).length());
+    visible.append(int(&node - nodes_.constData()));
+    distances.append(distance);
+    total += node.count;
+    nearest = nearest < 0 ? distance : qMin(nearest, distance);
+  }
+
+  double weightSum = 0;
+  if (total > budget)
+    for (int i = 0; i < visible.size(); i++)
+    {
+      double falloff = nearest / distances[i];
+      weightSum += nodes_[visible[i]].count * falloff * falloff;
+    }
+
+  for (int i = 0; i < visible.size(); i++)
+  {
+    const Node& node = nodes_[visible[i]];
+    int count = node.count;
+    if (total > budget)
+    {
+      double falloff = nearest / distances[i];
+      double share = budget * node.count * falloff * falloff / weightSum;
+      count = int(qBound(1.0, std::ceil(share), double(node.count)));
+    }
+    if (!ranges.isEmpty() &&
+        ranges.last().first + ranges.last().second == node.first)
+      ranges.last().second += count;
+    else
+      ranges.append(qMakePair(node.first, count));
+  }
+  return total;
+}
@@ -0,0 +1,50 @@
+#ifndef POINTOCTREE_H
+#define POINTOCTREE_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QMatrix4x4>
+#include <QPair>
+#include "Dataset.h"
+
+// Octree over a 3D point cloud for level of detail rendering. Building it
+// reorders the points (by Morton code, shuffled inside each leaf) so that
+// every node is a contiguous range and any prefix of a leaf is a uniform
+// sample of it. A frame then draws prefixes of the visible leaves, with
+// far leaves thinned more, within a point budget.
+class PointOctree
+{
+public:
+  static const int LeafSize = 4096;
+  static const int MaxDepth = 10;
+
+  struct Node
+  {
+    QVector3D min, max;
+    int first = 0;
+    int count = 0;
+    int children[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+    bool leaf = true;
+  };
+
+  void build(const Dataset& points);
+  void clear();
+  bool isEmpty() const { return nodes_.isEmpty(); };
+
+  // Slot in the reordered points for each original point and back
+  const QVector<quint32>& order() const { return order_; };
+  const QVector<quint32>& slots() const { return slots_; };
+
+  qint64 select(const QMatrix4x4& projection, const QMatrix4x4& modelView,
+                qint64 budget, QVector<QPair<int, int>>& ranges) const;
+
+private:
+  QVector<Node> nodes_;
+  QVector<quint32> order_;
+  QVector<quint32> slots_;
+
+  int buildNode(const QVector<quint64>& keys, int first, int count,
+                const QVector3D& min, const QVector3D& max, int depth);
+};
+
+#endif // POINTOCTREE_H
@@ -0,0 +1,380 @@
+#include "PointRenderer.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <algorithm>
+
+const QVector3D PointRenderer::DefaultEye(0.0f, 0.0f, 25.0f);
+const QVector3D PointRenderer::DefaultTarget(0.0f, 0.0f, 0.0f);
+
+PointRenderer::PointRenderer() :
+  m_pointProgram(nullptr),
+  m_pointBuffer(QOpenGLBuffer::VertexBuffer),
+  m_clusterBuffer(QOpenGLBuffer::VertexBuffer),
+  m_paletteTexture(nullptr)
+{
+  m_pointSize = 4.0f;
+  m_pointCount = 0;
+  m_clusterBytes = 1;
+  m_pointsDirty = true;
+  m_clustersDirty = true;
+  m_paletteDirty = true;
+  m_pointBudget = DefaultPointBudget;
+  m_frameBudget = m_pointBudget;
+}
+
+QMatrix4x4 PointRenderer::projection(const QSize& viewport)
+{
+  QMatrix4x4 matrix;
+  matrix.perspective(40.0, float(viewport.width())/viewport.height(),
+                     1.0f, 2000.0f);
+  return matrix;
+}
+
+QMatrix4x4 PointRenderer::lookAt(const QVector3D& eye,
+                                 const QVector3D& target)
+{
+  QMatrix4x4 matrix;
+  matrix.lookAt(eye, target, {0, 1, 0});
+  return matrix;
+}
+
+void PointRenderer::initialize()
+{
+  initializeOpenGLFunctions();
+  glEnable(GL_PROGRAM_POINT_SIZE);
+  glEnable(GL_POINT_SMOOTH);
+
+  delete m_pointProgram;
+  m_pointProgram = new QOpenGLShaderProgram();
+  m_pointProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexCode);
+  m_pointProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, fragCode);
+  m_pointProgram->link();
+
+  // Positions change once per data set, clusters after every step
+  m_pointBuffer.create();
+  m_pointBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+  m_clusterBuffer.create();
+  m_clusterBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+  m_pointsDirty = true;
+  m_clustersDirty = true;
+  m_paletteDirty = true;
+}
+
+void PointRenderer::destroy()
+{
+  m_pointBuffer.destroy();
+  m_clusterBuffer.destroy();
+  delete m_paletteTexture;
+  m_paletteTexture = nullptr;
+  delete m_pointProgram;
+  m_pointProgram = nullptr;
+}
+
+// Setting the data set that is already shown keeps its octree
+void PointRenderer::setPoints(const DatasetPtr& dataset)
+{
+  if (dataset == m_dataset)
+    return;
+  m_dataset = dataset;
+  const bool valid = !m_dataset.isNull() && m_dataset->dimensions() == 3;
+  m_pointCount = valid ? m_dataset->size() : 0;
+  if (valid)
+    m_octree.build(*m_dataset);
+  else
+    m_octree.clear();
+  m_pointsDirty = true;
+  m_frameBudget = m_pointBudget;
+
+  // The slots changed, so previous clusters no longer line up
+  m_clusters.clear();
+  resizeClusters(m_pointCount, m_clusterBytes);
+}
+
+// Cluster i is drawn in colors[i]. The index width follows the palette
+// size, so small k uploads one byte per point.
+void PointRenderer::setPalette(const QVector<QColor>& colors)
+{
+  m_palette = colors;
+  m_paletteDirty = true;
+  int bytes = m_palette.size() < 0xFF ? 1 : m_palette.size() < 0xFFFF ? 2 : 4;
+  if (bytes != m_clusterBytes)
+    resizeClusters(pointCount(), bytes);
+}
+
+void PointRenderer::setPointClusters(const QVector<quint32>& clusters)
+{
+  const int n = qMin(clusters.size(), pointCount());
+  for (int i = 0; i < n; i++)
+    writeCluster(i, clusters[i]);
+  m_clustersDirty = true;
+  m_dirtyClusters.clear();
+}
+
+// Only the changed points are uploaded on the next frame, unless so many
+// change that a full upload is cheaper. Returns true for the first change
+// since the last upload.
+bool PointRenderer::setPointCluster(int index, quint32 cluster)
+{
+  writeCluster(index, cluster);
+  if (m_clustersDirty)
+    return false;
+  bool first = m_dirtyClusters.isEmpty();
+  m_dirtyClusters.append(m_octree.isEmpty() ? index
+                                            : int(m_octree.slots()[index]));
+  if (m_dirtyClusters.size() > pointCount() / 4)
+  {
+    m_clustersDirty = true;
+    m_dirtyClusters.clear();
+  }
+  return first;
+}
+
+void PointRenderer::setCentroidPoints(const QVector<float>& centroids)
+{
+  m_centroids = centroids;
+  // Centroid i takes palette entry i
+  m_centroidClusters.resize(m_centroids.size() / 3);
+  for (int i = 0; i < m_centroidClusters.size(); i++)
+    m_centroidClusters[i] = i;
+}
+
+void PointRenderer::setPointSize(float pointsize)
+{
+  m_pointSize = pointsize;
+}
+
+void PointRenderer::setPointBudget(int points)
+{
+  m_pointBudget = points;
+  m_frameBudget = m_pointBudget;
+}
+
+void PointRenderer::reset()
+{
+  m_pointSize = 4.0f;
+  m_centroids.clear();
+  m_centroidClusters.clear();
+  // Every point back to unassigned, the width stays
+  m_clusters.fill(char(0xFF), pointCount() * m_clusterBytes);
+  m_clustersDirty = true;
+  m_dirtyClusters.clear();
+}
+
+int PointRenderer::pointCount() const
+{
+  return m_pointCount;
+}
+
+void PointRenderer::upload()
+{
+  TRACE_SCOPE("PointRenderer::upload", "render");
+  if (m_pointsDirty)
+  {
+    // Interleaved in octree order only for as long as the upload takes
+    QVector<float> points(3 * m_pointCount);
+    if (m_pointCount > 0)
+    {
+      const double* const* xyz = m_dataset->columnData();
+      const quint32* order = m_octree.order().constData();
+      float* sorted = points.data();
+      parallelChunks(m_pointCount, 1 << 16, [&](int, qint64 begin, qint64 end)
+      {
+        for (qint64 slot = begin; slot < end; slot++)
+        {
+          const quint32 i = order[slot];
+          sorted[3 * slot] = xyz[0][i];
+          sorted[3 * slot + 1] = xyz[1][i];
+          sorted[3 * slot + 2] = xyz[2][i];
+        }
+      }, 0, ThreadPool::Low);
+    }
+    m_pointBuffer.bind();
+    m_pointBuffer.allocate(points.constData(),
+                           points.size() * int(sizeof(float)));
+    m_pointsDirty = false;
+  }
+
+  if (m_clustersDirty)
+  {
+    m_clusterBuffer.bind();
+    m_clusterBuffer.allocate(m_clusters.constData(), m_clusters.size());
+    m_clustersDirty = false;
+  }
+  else if (!m_dirtyClusters.isEmpty())
+  {
+    // Coalesce the changed points into runs and write each with one
+    // glBufferSubData call
+    std::sort(m_dirtyClusters.begin(), m_dirtyClusters.end());
+    m_clusterBuffer.bind();
+    int i = 0;
+    while (i < m_dirtyClusters.size())
+    {
+      int begin = m_dirtyClusters[i];
+      int end = begin + 1;
+      for (i++; i < m_dirtyClusters.size() &&
+                m_dirtyClusters[i] <= end + MaxClusterGap; i++)
+        end = qMax(end, m_dirtyClusters[i] + 1);
+      m_clusterBuffer.write(begin * m_clusterBytes,
+                            m_clusters.constData() + begin * m_clusterBytes,
+                            (end - begin) * m_clusterBytes);
+    }
+  }
+  m_dirtyClusters.clear();
+
+  if (m_paletteDirty || m_paletteTexture == nullptr)
+    uploadPalette();
+}
+
+// Draws points and centroids with the given camera. Returns true when not
+// every visible point made it into the frame and a still camera should
+// draw again to refine.
+bool PointRenderer::render(const QMatrix4x4& projection,
+                           const QMatrix4x4& modelView, bool moving)
+{
+  TRACE_SCOPE("PointRenderer::render", "render");
+  QMatrix4x4 pmvMatrix = projection * modelView;
+
+  m_pointProgram->bind();
+  m_pointProgram->enableAttributeArray("vertex");
+  m_pointProgram->enableAttributeArray("cluster");
+
+  m_pointProgram->setUniformValue("matrix", pmvMatrix);
+  m_paletteTexture->bind(0);
+  m_pointProgram->setUniformValue("palette", 0);
+  m_pointProgram->setUniformValue("paletteSize", float(m_palette.size() + 1));
+  m_pointProgram->setUniformValue("paletteRows",
+                                  float(m_paletteTexture->height()));
+
+  m_pointBuffer.bind();
+  m_pointProgram->setAttributeBuffer("vertex", GL_FLOAT, 0, 3);
+  // Not through setAttributeBuffer, which normalizes integer attributes
+  m_clusterBuffer.bind();
+  glVertexAttribPointer(m_pointProgram->attributeLocation("cluster"), 1,
+                        clusterType(), GL_FALSE, 0, nullptr);
+
+  glPointSize(m_pointSize);
+  bool refine = false;
+  if (pointCount() <= m_pointBudget || m_octree.isEmpty())
+    glDrawArrays(GL_POINTS, 0, pointCount());
+  else
+    refine = drawLevelOfDetail(projection, modelView, moving);
+
+  // Centroids are few and stay in client memory
+  QOpenGLBuffer::release(QOpenGLBuffer::VertexBuffer);
+
+  m_pointProgram->disableAttributeArray("vertex");
+  m_pointProgram->enableAttributeArray("vertex");
+  m_pointProgram->setAttributeArray("vertex", m_centroids.constData(), 3);
+  m_pointProgram->setAttributeArray("cluster", m_centroidClusters.constData(), 1);
+  glPointSize(m_pointSize + 20.0f);
+  glDrawArrays(GL_POINTS, 0, m_centroids.count()/3);
+  m_pointProgram->disableAttributeArray("vertex");
+  m_pointProgram->disableAttributeArray("cluster");
+  m_paletteTexture->release(0);
+  m_pointProgram->release();
+  return refine;
+}
+
+// Draws the visible octree leaves within the frame budget. While the camera
+// stays put the budget doubles every frame until all visible points are in.
+bool PointRenderer::drawLevelOfDetail(const QMatrix4x4& projection,
+                                      const QMatrix4x4& modelView, bool moving)
+{
+  QMatrix4x4 pmvMatrix = projection * modelView;
+  if (pmvMatrix != m_lastMatrix)
+  {
+    m_frameBudget = m_pointBudget;
+    m_lastMatrix = pmvMatrix;
+  }
+
+  qint64 visible = m_octree.select(projection, modelView, m_frameBudget,
+                                   m_drawRanges);
+  for (const QPair<int, int>& range : m_drawRanges)
+    glDrawArrays(GL_POINTS, range.first, range.second);
+
+  if (visible > m_frameBudget && !moving)
+  {
+    m_frameBudget *= 2;
+    return true;
+  }
+  return false;
+}
+
+void PointRenderer::uploadPalette()
+{
+  const int entries = m_palette.size() + 1;
+  const int rows = (entries + PaletteWidth - 1) / PaletteWidth;
+  QVector<quint8> texels(4 * PaletteWidth * rows, 0);
+  for (int i = 0; i < entries; i++)
+  {
+    // Unassigned points keep the cyan they had before clustering
+    QColor color = i < m_palette.size() ? m_palette[i] : QColor(0, 255, 255);
+    texels[4 * i] = quint8(color.red());
+    texels[4 * i + 1] = quint8(color.green());
+    texels[4 * i + 2] = quint8(color.blue());
+    texels[4 * i + 3] = 255;
+  }
+
+  delete m_paletteTexture;
+  m_paletteTexture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+  m_paletteTexture->setSize(PaletteWidth, rows);
+  m_paletteTexture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+  m_paletteTexture->setMinificationFilter(QOpenGLTexture::Nearest);
+  m_paletteTexture->setMagnificationFilter(QOpenGLTexture::Nearest);
+  m_paletteTexture->setWrapMode(QOpenGLTexture::ClampToEdge);
+  m_paletteTexture->allocateStorage();
+  m_paletteTexture->setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8,
+                            texels.constData());
+  m_paletteDirty = false;
+}
+
+// Resizes to count unassigned points of the given width, keeping the
+// clusters of points that already had one
+void PointRenderer::resizeClusters(int count, int bytes)
+{
+  QByteArray old = m_clusters;
+  int oldBytes = m_clusterBytes;
+  int oldCount = old.size() / oldBytes;
+
+  m_clusterBytes = bytes;
+  m_clusters.fill(char(0xFF), count * bytes);
+  for (int i = 0; i < qMin(count, oldCount); i++)
+  {
+    quint32 cluster = readCluster(old.constData() + i * oldBytes, oldBytes);
+    if (cluster != quint32(0xFFFFFFFFu >> (32 - 8 * oldBytes)))
+      writeSlot(i, cluster);
+  }
+  m_clustersDirty = true;
+  m_dirtyClusters.clear();
+}
+
+quint32 PointRenderer::readCluster(const char* at, int bytes)
+{
+  if (bytes == 1)
+    return *reinterpret_cast<const quint8*>(at);
+  if (bytes == 2)
+    return *reinterpret_cast<const quint16*>(at);
+  return *reinterpret_cast<const quint32*>(at);
+}
+
+void PointRenderer::writeCluster(int index, quint32 cluster)
+{
+  writeSlot(m_octree.isEmpty() ? index : int(m_octree.slots()[index]), cluster);
+}
+
+void PointRenderer::writeSlot(int slot, quint32 cluster)
+{
+  char* at = m_clusters.data() + slot * m_clusterBytes;
+  if (m_clusterBytes == 1)
+    *reinterpret_cast<quint8*>(at) = quint8(cluster);
+  else if (m_clusterBytes == 2)
+    *reinterpret_cast<quint16*>(at) = quint16(cluster);
+  else
+    *reinterpret_cast<quint32*>(at) = cluster;
+}
+
+GLenum PointRenderer::clusterType() const
+{
+  return m_clusterBytes == 1 ? GL_UNSIGNED_BYTE :
+         m_clusterBytes == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
@@ -0,0 +1,115 @@
+#ifndef POINTRENDERER_H
+#define POINTRENDERER_H
+
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QOpenGLTexture>
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QSize>
+#include <QColor>
+#include <QVector>
+#include "PointOctree.h"
+#include "Dataset.h"
+
+// The OpenGL side of the 3D view: point and cluster buffers, the palette
+// texture and the octree level of detail. It draws into whatever context is
+// current, so ViewWidget and the offscreen benchmark share it. Positions are
+// read from the shared data set when they are uploaded and not kept around.
+class PointRenderer : protected QOpenGLFunctions
+{
+public:
+  // Cluster updates closer than this many points are uploaded as one range
+  static const int MaxClusterGap = 256;
+  // Texels per row of the palette texture, matches vertexCode
+  static const int PaletteWidth = 256;
+  // Points drawn per frame while the camera moves, larger data sets go
+  // through the octree
+  static const int DefaultPointBudget = 1000000;
+  // Camera of the 3D view before the user moves it
+  static const QVector3D DefaultEye;
+  static const QVector3D DefaultTarget;
+
+  PointRenderer();
+
+  // Camera matrices of the 3D view, shared with the offscreen benchmark
+  static QMatrix4x4 projection(const QSize& viewport);
+  static QMatrix4x4 lookAt(const QVector3D& eye, const QVector3D& target);
+
+  // Both need the context current
+  void initialize();
+  void destroy();
+
+  void setPoints(const DatasetPtr& dataset);
+  void setPalette(const QVector<QColor>& colors);
+  void setPointClusters(const QVector<quint32>& clusters);
+  bool setPointCluster(int index, quint32 cluster);
+  void setCentroidPoints(const QVector<float>& centroids);
+  void setPointSize(float pointsize);
+  void setPointBudget(int points);
+  void reset();
+  int pointCount() const;
+
+  void upload();
+  bool render(const QMatrix4x4& projection, const QMatrix4x4& modelView,
+              bool moving);
+
+private:
+  float m_pointSize;
+  DatasetPtr m_dataset;
+  int m_pointCount;
+  QVector<float> m_centroids;
+  QVector<float> m_centroidClusters;
+  QVector<QColor> m_palette;
+  // One cluster index per point, 1, 2 or 4 bytes wide depending on the
+  // palette size; all bits set means unassigned
+  QByteArray m_clusters;
+  int m_clusterBytes;
+  QOpenGLShaderProgram* m_pointProgram;
+  QOpenGLBuffer m_pointBuffer, m_clusterBuffer;
+  QOpenGLTexture* m_paletteTexture;
+  bool m_pointsDirty, m_clustersDirty, m_paletteDirty;
+  QVector<int> m_dirtyClusters;
+  // Points and clusters are stored in octree order
+  PointOctree m_octree;
+  qint64 m_pointBudget, m_frameBudget;
+  QMatrix4x4 m_lastMatrix;
+  QVector<QPair<int, int>> m_drawRanges;
+
+  bool drawLevelOfDetail(const QMatrix4x4& projection,
+                         const QMatrix4x4& modelView, bool moving);
+  void uploadPalette();
+  void resizeClusters(int count, int bytes);
+  void writeCluster(int index, quint32 cluster);
+  void writeSlot(int slot, quint32 cluster);
+  GLenum clusterType() const;
+  static quint32 readCluster(const char* at, int bytes);
+
+  // Colors come from the palette texture, the entry past the clusters is
+  // the color of unassigned points
+  const char* vertexCode =
+    "attribute highp vec4 vertex;\n"
+    "attribute highp float cluster;\n"
+    "varying mediump vec4 vColor;\n"
+    "uniform highp mat4 matrix;\n"
+    "uniform sampler2D palette;\n"
+    "uniform highp float paletteSize;\n"
+    "uniform highp float paletteRows;\n"
+    "void main(void)\n"
+    "{\n"
+    "   gl_Position = matrix * vertex;\n"
+    "   highp float index = min(cluster, paletteSize - 1.0);\n"
+    "   highp float row = floor(index / 256.0);\n"
+    "   highp vec2 texel = vec2(index - row * 256.0 + 0.5, row + 0.5);\n"
+    "   vColor = texture2DLod(palette, texel / vec2(256.0, paletteRows), 0.0);\n"
+    "}";
+  const char* fragCode =
+    "varying mediump vec4 vColor;\n"
+    "void main(void)\n"
+    "{\n"
+    "   gl_FragColor = vColor;\n"
+    "}";
+};
+
+#endif // POINTRENDERER_H
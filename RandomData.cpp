@@ -1,17 +1,149 @@
 #include "RandomData.h"
+#include "Parallel.h"
+#include "Philox.h"
+#include "Trace.h"
+#include <algorithm>
+#include <utility>
 
-QVector<double> RandomData::Generate(uDistd& dist, std::mt19937_64& gen,
-                                     qint32 total)
+namespace
 {
-  QVector<double> randVec;
+const qint64 GenerateChunk = 1 << 14;
+// Blob parameters are drawn from their own stream, past any point stream
+const quint32 ModelStreamBit = 0x80000000u;
 
-  for (qint32 i = 0; i < total; i++)
-    randVec.push_back(dist(gen));
+// One Gaussian blob: x = center + transform * z for standard normal z
+struct Blob
+{
+  double center[3];
+  double transform[3][3];
+};
+
+// Uniformly random rotation: an angle in 2D, a unit quaternion in 3D
+void randomRotation(PhiloxDraws& draws, int dimensions, double r[3][3])
+{
+  if (dimensions == 2)
+  {
+    const double theta = 2.0 * M_PI * draws.uniform();
+    r[0][0] = qCos(theta);
+    r[0][1] = -qSin(theta);
+    r[1][0] = qSin(theta);
+    r[1][1] = qCos(theta);
+    return;
+  }
+
+  double q[4];
+  draws.normals(q[0], q[1]);
+  draws.normals(q[2], q[3]);
+  const double norm = qSqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] +
+                            q[3] * q[3]);
+  const double w = q[0] / norm, x = q[1] / norm;
+  const double y = q[2] / norm, z = q[3] / norm;
+  r[0][0] = 1 - 2 * (y * y + z * z);
+  r[0][1] = 2 * (x * y - z * w);
+  r[0][2] = 2 * (x * z + y * w);
+  r[1][0] = 2 * (x * y + z * w);
+  r[1][1] = 1 - 2 * (x * x + z * z);
+  r[1][2] = 2 * (y * z - x * w);
+  r[2][0] = 2 * (x * z - y * w);
+  r[2][1] = 2 * (y * z + x * w);
+  r[2][2] = 1 - 2 * (x * x + y * y);
+}
+
+QVector<Blob> makeBlobs(const RandomData::Options& options,
+                        QVector<double>& cdf)
+{
+  const int k = qMax(1, options.clusters);
+  const int dims = options.dimensions;
+  QVector<Blob> blobs(k);
+  QVector<double> weights(k, 1.0);
+  for (int c = 0; c < k; c++)
+  {
+    PhiloxDraws draws(options.seed, options.stream | ModelStreamBit,
+                      quint64(c));
+    Blob& blob = blobs[c];
+    double scale[3];
+    for (int d = 0; d < 3; d++)
+    {
+      const double extent = d < dims ? options.max[d] - options.min[d] : 0.0;
+      blob.center[d] = d < dims ? draws.uniform(options.min[d] + 0.1 * extent,
+                                                options.max[d] - 0.1 * extent)
+                                : 0.0;
+      scale[d] = options.spread * extent;
+    }
 
-  return randVec;
+    double rotation[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    if (options.distribution == RandomData::Anisotropic)
+    {
+      // Axis lengths spread log-uniformly over the anisotropy ratio
+      for (int d = 0; d < dims; d++)
+        scale[d] *= qPow(options.anisotropy, draws.uniform() - 0.5);
+      randomRotation(draws, dims, rotation);
+    }
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+        blob.transform[i][j] = rotation[i][j] * scale[j];
+
+    if (options.distribution == RandomData::Imbalanced && k > 1)
+      weights[c] = qPow(options.imbalance, -double(c) / (k - 1));
+  }
+
+  cdf.resize(k);
+  double total = 0.0;
+  for (int c = 0; c < k; c++)
+    cdf[c] = total += weights[c];
+  for (double& v : cdf)
+    v /= total;
+  return blobs;
+}
 }
 
-double RandomData::Next(uDistd& dist, std::mt19937_64& gen)
+DatasetPtr RandomData::Generate(const Options& options)
 {
-  return dist(gen);
+  TRACE_SCOPE("RandomData::Generate", "data");
+  const qint32 n = qMax(0, options.count);
+  const int dims = options.dimensions == 3 ? 3 : 2;
+  QVector<double> columns[3];
+  for (int d = 0; d < dims; d++)
+    columns[d].resize(n);
+  double* out[3] = {columns[0].data(), columns[1].data(),
+                    dims == 3 ? columns[2].data() : nullptr};
+
+  QVector<double> cdf;
+  QVector<Blob> blobs;
+  if (options.distribution != Uniform)
+    blobs = makeBlobs(options, cdf);
+  const Blob* blob = blobs.constData();
+  const double* weights = cdf.constData();
+  const int k = blobs.size();
+
+  parallelChunks(n, GenerateChunk, [&](int, qint64 begin, qint64 end)
+  {
+    for (qint64 i = begin; i < end; i++)
+    {
+      PhiloxDraws draws(options.seed, options.stream, quint64(i));
+      if (k == 0)
+      {
+        for (int d = 0; d < dims; d++)
+          out[d][i] = draws.uniform(options.min[d], options.max[d]);
+        continue;
+      }
+
+      const double pick = draws.uniform();
+      const int c = qMin(k - 1, int(std::upper_bound(weights, weights + k,
+                                                     pick) - weights));
+      double z[4];
+      draws.normals(z[0], z[1]);
+      draws.normals(z[2], z[3]);
+      for (int d = 0; d < dims; d++)
+      {
+        double v = blob[c].center[d];
+        for (int j = 0; j < dims; j++)
+          v += blob[c].transform[d][j] * z[j];
+        out[d][i] = v;
+      }
+    }
+  });
+
+  return DatasetPtr(new Dataset(std::move(columns[0]), std::move(columns[1]),
+                                std::move(columns[2])));
 }
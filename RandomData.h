@@ -1,17 +1,44 @@
 #ifndef RANDOMDATA_H
 #define RANDOMDATA_H
 
-#include <random>
 #include <QVector>
+#include "Dataset.h"
 
-typedef std::uniform_real_distribution<double> uDistd;
-
+// Synthetic data sets. Every coordinate is a pure function of the seed, the
+// stream and the point index (see Philox.h), so the columns are filled in
+// parallel and a seed gives the same data set for any number of threads.
 class RandomData
 {
 public:
-  static QVector<double> Generate(uDistd& dist, std::mt19937_64& gen,
-                                  qint32 total);
-  static double Next(uDistd& dist, std::mt19937_64& gen);
+  enum Distribution {Uniform, Blobs, Anisotropic, Imbalanced};
+
+  // Streams keep different uses of one seed independent
+  static const quint32 DataStream = 0;
+  static const quint32 CentroidStream = 1;
+  static const quint32 SampleStream = 2;
+  static const quint32 KppStream = 3;
+  static const quint32 CoresetStream = 4;
+
+  struct Options
+  {
+    Distribution distribution = Uniform;
+    quint64 seed = 1;
+    quint32 stream = DataStream;
+    qint32 count = 0;
+    int dimensions = 2;
+    double min[3] = {-10.0, -10.0, -10.0};
+    double max[3] = {10.0, 10.0, 10.0};
+    // Number of Gaussian blobs, their centers are uniform in the bounds
+    int clusters = 8;
+    // Blob standard deviation as a share of each dimension's extent
+    double spread = 0.05;
+    // Longest over shortest blob axis, for Anisotropic
+    double anisotropy = 6.0;
+    // Largest over smallest blob share of the points, for Imbalanced
+    double imbalance = 20.0;
+  };
+
+  static DatasetPtr Generate(const Options& options);
 };
 
 #endif // RANDOMDATA_H
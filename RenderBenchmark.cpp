@@ -0,0 +1,148 @@
+#include "RenderBenchmark.h"
+#include "Benchmark.h"
+#include "PointRenderer.h"
+#include "RandomData.h"
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDebug>
+#include <climits>
+#include <random>
+
+namespace
+{
+// Clears the target and draws one frame from the default ViewWidget camera,
+// then waits until the GPU is done so the time covers the whole frame
+void drawFrame(PointRenderer& renderer, QOpenGLFunctions* gl,
+               const QSize& size, bool moving)
+{
+  gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  renderer.render(PointRenderer::projection(size),
+                  PointRenderer::lookAt(PointRenderer::DefaultEye,
+                                        PointRenderer::DefaultTarget),
+                  moving);
+  gl->glFinish();
+}
+}
+
+int RenderBenchmark::run(const Options& options)
+{
+  QOffscreenSurface surface;
+  surface.create();
+  QOpenGLContext context;
+  if (!context.create() || !context.makeCurrent(&surface))
+  {
+    qCritical() << "Could not create an OpenGL context";
+    return 1;
+  }
+  QOpenGLFunctions* gl = context.functions();
+
+  QOpenGLFramebufferObjectFormat format;
+  format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+  QOpenGLFramebufferObject fbo(options.frameSize, format);
+  fbo.bind();
+  gl->glViewport(0, 0, options.frameSize.width(), options.frameSize.height());
+  gl->glClearColor(0.25, 0.25, 0.25, 1.0);
+  gl->glEnable(GL_DEPTH_TEST);
+
+  QFile file;
+  if (options.output.isEmpty())
+    file.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+  else
+  {
+    file.setFileName(options.output);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+      qCritical() << "Could not write" << options.output;
+      return 1;
+    }
+  }
+  BenchmarkWriter writer(&file);
+
+  QVector<QColor> palette;
+  for (int i = 0; i < options.k; i++)
+    palette.push_back(QColor::fromHsv(360 * i / options.k, 255, 255));
+
+  PointRenderer renderer;
+  renderer.initialize();
+  renderer.setPalette(palette);
+
+  // A fixed seed keeps runs comparable
+  std::mt19937_64 gen(42);
+  std::uniform_int_distribution<quint32> clusterDist(0, options.k - 1);
+  QElapsedTimer timer;
+
+  for (qint64 n : options.sizes)
+  {
+    RandomData::Options data;
+    data.seed = 42;
+    data.count = qint32(n);
+    data.dimensions = 3;
+    DatasetPtr dataset = RandomData::Generate(data);
+    QVector<quint32> clusters(int(n));
+    for (quint32& cluster : clusters)
+      cluster = clusterDist(gen);
+
+    QVector<double> setPoints, uploadPoints, drawFull, drawLod;
+    QVector<double> recolorStep, recolorFull;
+    const int stepChanges = qMax(1, int(n * options.stepFraction));
+    for (int r = 0; r < options.repeats; r++)
+    {
+      // The renderer keeps the octree of a data set it already shows
+      renderer.setPoints(DatasetPtr());
+      timer.start();
+      renderer.setPoints(dataset);
+      setPoints.push_back(timer.nsecsElapsed() / 1.0e6);
+
+      timer.start();
+      renderer.upload();
+      gl->glFinish();
+      uploadPoints.push_back(timer.nsecsElapsed() / 1.0e6);
+
+      timer.start();
+      renderer.setPointClusters(clusters);
+      renderer.upload();
+      gl->glFinish();
+      recolorFull.push_back(timer.nsecsElapsed() / 1.0e6);
+
+      // One k-means step worth of reassignments, uploaded as ranges
+      timer.start();
+      for (int i = 0; i < stepChanges; i++)
+      {
+        int point = int(gen() % quint64(n));
+        renderer.setPointCluster(point, clusterDist(gen));
+      }
+      renderer.upload();
+      gl->glFinish();
+      recolorStep.push_back(timer.nsecsElapsed() / 1.0e6);
+
+      renderer.setPointBudget(INT_MAX);
+      timer.start();
+      drawFrame(renderer, gl, options.frameSize, true);
+      drawFull.push_back(timer.nsecsElapsed() / 1.0e6);
+
+      renderer.setPointBudget(PointRenderer::DefaultPointBudget);
+      timer.start();
+      drawFrame(renderer, gl, options.frameSize, true);
+      drawLod.push_back(timer.nsecsElapsed() / 1.0e6);
+    }
+
+    writer.row("render", n, options.k, 1, "set_points", medianMs(setPoints));
+    writer.row("render", n, options.k, 1, "upload_points",
+               medianMs(uploadPoints));
+    writer.row("render", n, options.k, 1, "recolor_full",
+               medianMs(recolorFull));
+    writer.row("render", n, options.k, 1, "recolor_step",
+               medianMs(recolorStep));
+    writer.row("render", n, options.k, 1, "draw_full", medianMs(drawFull));
+    writer.row("render", n, options.k, 1, "draw_lod", medianMs(drawLod));
+  }
+
+  renderer.destroy();
+  fbo.release();
+  context.doneCurrent();
+  return 0;
+}
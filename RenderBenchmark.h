@@ -0,0 +1,30 @@
+#ifndef RENDERBENCHMARK_H
+#define RENDERBENCHMARK_H
+
+#include <QVector>
+#include <QString>
+#include <QSize>
+
+// Renders the 3D pipeline into an offscreen framebuffer, so the cost of the
+// view can be measured without a display (QT_QPA_PLATFORM=offscreen, Mesa
+// llvmpipe works). Rows go out in the Benchmark.h CSV format.
+class RenderBenchmark
+{
+public:
+  struct Options
+  {
+    QVector<qint64> sizes = {100000, 1000000, 10000000};
+    int k = 16;
+    int repeats = 5;
+    // Share of points that change cluster in one recolor step
+    double stepFraction = 0.01;
+    QSize frameSize = QSize(1280, 720);
+    // Empty writes to stdout
+    QString output;
+  };
+
+  // Returns the process exit code
+  static int run(const Options& options);
+};
+
+#endif // RENDERBENCHMARK_H
@@ -0,0 +1,341 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <QThread>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+int ThreadPool::configuredThreads_ = 0;
+bool ThreadPool::configuredPinning_ = false;
+bool ThreadPool::configuredNuma_ = false;
+std::atomic<bool> ThreadPool::created_(false);
+
+// Index of the calling thread's worker, -1 outside the pool
+static thread_local int currentWorker = -1;
+
+namespace
+{
+// Parses a kernel cpu list such as "0-15,32-47"
+std::vector<int> parseCpuList(const QString& list)
+{
+  std::vector<int> cpus;
+  for (const QString& range : list.trimmed().split(','))
+  {
+    if (range.isEmpty())
+      continue;
+    QStringList bounds = range.split('-');
+    int first = bounds[0].toInt();
+    int last = bounds.size() > 1 ? bounds[1].toInt() : first;
+    for (int cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+std::vector<std::vector<int>> memoryNodes()
+{
+  std::vector<std::vector<int>> nodes;
+#ifdef Q_OS_LINUX
+  QDir dir("/sys/devices/system/node");
+  QStringList names = dir.entryList({"node*"}, QDir::Dirs);
+  std::sort(names.begin(), names.end(), [](const QString& a, const QString& b)
+            { return a.mid(4).toInt() < b.mid(4).toInt(); });
+  for (const QString& name : names)
+  {
+    QFile file(dir.filePath(name + "/cpulist"));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+      continue;
+    std::vector<int> cpus = parseCpuList(QString::fromLatin1(file.readAll()));
+    // Memory only nodes have no cores to run on
+    if (!cpus.empty())
+      nodes.push_back(cpus);
+  }
+#endif
+  if (nodes.empty())
+  {
+    nodes.emplace_back();
+    for (int cpu = 0; cpu < qMax(1, QThread::idealThreadCount()); cpu++)
+      nodes.back().push_back(cpu);
+  }
+  return nodes;
+}
+
+void bindThread(std::thread& thread, const std::vector<int>& cpus)
+{
+#ifdef Q_OS_LINUX
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+    CPU_SET(cpu, &set);
+  pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+  Q_UNUSED(thread);
+  Q_UNUSED(cpus);
+#endif
+}
+}
+
+ThreadPool& ThreadPool::instance()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+void ThreadPool::configure(int threads, bool pinThreads, bool numa)
+{
+  configuredThreads_ = threads;
+  configuredPinning_ = pinThreads;
+  configuredNuma_ = numa;
+  if (created_)
+  {
+    ThreadPool& pool = instance();
+    pool.stop();
+    pool.start(threads, pinThreads, numa);
+  }
+}
+
+ThreadPool::ThreadPool() :
+  queued_(0), nextWorker_(0), stopping_(false), numa_(false),
+  nodeCpus_(memoryNodes())
+{
+  start(configuredThreads_, configuredPinning_, configuredNuma_);
+  created_ = true;
+}
+
+ThreadPool::~ThreadPool()
+{
+  stop();
+}
+
+void ThreadPool::start(int threads, bool pinThreads, bool numa)
+{
+  if (threads <= 0)
+    threads = QThread::idealThreadCount();
+  stopping_ = false;
+  numa_ = numa;
+  const int cores = qMax(1, QThread::idealThreadCount());
+  const int workers = threads - 1;
+  const int nodes = nodeCount();
+  for (int i = 0; i < workers; i++)
+  {
+    workers_.emplace_back(new Worker);
+    workers_[i]->homeQueued = 0;
+    workers_[i]->node = numa ? i * nodes / workers : 0;
+  }
+  for (int i = 0; i < workers; i++)
+  {
+    Worker& worker = *workers_[i];
+    worker.thread = std::thread(&ThreadPool::workerLoop, this, i);
+    if (numa)
+    {
+      // Workers of a node are contiguous, the node's first worker gets its
+      // first core when pinned
+      const std::vector<int>& cpus = nodeCpus_[worker.node];
+      const int firstOfNode = (worker.node * workers + nodes - 1) / nodes;
+      if (pinThreads)
+        bindThread(worker.thread, {cpus[(i - firstOfNode) % cpus.size()]});
+      else
+        bindThread(worker.thread, cpus);
+    }
+    else if (pinThreads)
+      bindThread(worker.thread, {(i + 1) % cores});
+  }
+}
+
+void ThreadPool::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::unique_ptr<Worker>& worker : workers_)
+    worker->thread.join();
+  workers_.clear();
+}
+
+void ThreadPool::run(int count, const std::function<void(int)>& task,
+                     Priority priority)
+{
+  if (count <= 0)
+    return;
+  if (count == 1 || workers_.empty())
+  {
+    for (int i = 0; i < count; i++)
+      task(i);
+    return;
+  }
+
+  Job job;
+  job.task = &task;
+  job.remaining = count;
+
+  // Workers queue on their own deque for the others to steal, other threads
+  // spread the tasks over all of them
+  const int self = currentWorker;
+  const int n = int(workers_.size());
+  queued_ += count;
+  if (self >= 0)
+  {
+    std::lock_guard<std::mutex> lock(workers_[self]->mutex);
+    for (int i = 0; i < count; i++)
+      workers_[self]->queues[priority].push_back({&job, i});
+  }
+  else
+  {
+    const int first = int(nextWorker_++ % quint32(n));
+    for (int w = 0; w < n && w < count; w++)
+    {
+      Worker& worker = *workers_[(first + w) % n];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      for (int i = w; i < count; i += n)
+        worker.queues[priority].push_back({&job, i});
+    }
+  }
+  {
+    // Pairs with the wait in workerLoop() so no wakeup is lost
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+  }
+  wake_.notify_all();
+
+  // Normal callers leave low priority work to the workers so they aren't
+  // held up by it
+  wait(job, self, priority);
+}
+
+void ThreadPool::runOn(int count, const std::function<int(int)>& worker,
+                       const std::function<void(int)>& task)
+{
+  if (count <= 0)
+    return;
+  if (workers_.empty())
+  {
+    for (int i = 0; i < count; i++)
+      task(i);
+    return;
+  }
+
+  Job job;
+  job.task = &task;
+  job.remaining = count;
+  for (int i = 0; i < count; i++)
+  {
+    Worker& home = *workers_[worker(i)];
+    std::lock_guard<std::mutex> lock(home.mutex);
+    home.queues[HomeQueue].push_back({&job, i});
+    home.homeQueued++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+  }
+  wake_.notify_all();
+  wait(job, currentWorker, Normal);
+}
+
+// Helps with queued tasks until the job is done
+void ThreadPool::wait(Job& job, int self, Priority lowest)
+{
+  while (job.remaining.load() > 0)
+  {
+    Task next;
+    if (take(self, lowest, next))
+    {
+      execute(next);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.done.wait(lock, [&job]() { return job.remaining.load() == 0; });
+  }
+  // The last task may still be signalling, the job must outlive that
+  std::lock_guard<std::mutex> lock(job.mutex);
+}
+
+void ThreadPool::workerLoop(int self)
+{
+  currentWorker = self;
+  Worker& own = *workers_[self];
+  while (true)
+  {
+    Task task;
+    if (take(self, Low, task))
+    {
+      execute(task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleepMutex_);
+    wake_.wait(lock, [this, &own]()
+    {
+      return stopping_ || queued_.load() > 0 || own.homeQueued.load() > 0;
+    });
+    if (stopping_)
+      return;
+  }
+}
+
+// Own home tasks first, then for each priority the newest task of the own
+// queue and the oldest task of another worker's
+bool ThreadPool::take(int self, Priority lowest, Task& task)
+{
+  const int n = int(workers_.size());
+  if (self >= 0 && workers_[self]->homeQueued.load() > 0)
+  {
+    Worker& own = *workers_[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.queues[HomeQueue].empty())
+    {
+      task = own.queues[HomeQueue].front();
+      own.queues[HomeQueue].pop_front();
+      own.homeQueued--;
+      return true;
+    }
+  }
+  for (int p = Normal; p <= lowest; p++)
+  {
+    if (self >= 0)
+    {
+      Worker& own = *workers_[self];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.queues[p].empty())
+      {
+        task = own.queues[p].back();
+        own.queues[p].pop_back();
+        queued_--;
+        return true;
+      }
+    }
+    const int first = self >= 0 ? self + 1 : 0;
+    for (int v = 0; v < n; v++)
+    {
+      Worker& victim = *workers_[(first + v) % n];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.queues[p].empty())
+      {
+        task = victim.queues[p].front();
+        victim.queues[p].pop_front();
+        queued_--;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::execute(const Task& task)
+{
+  Job* job = task.job;
+  {
+    // One span per work item, on the track of the thread that ran it
+    TRACE_SCOPE("pool task", "pool");
+    (*job->task)(task.index);
+  }
+  std::lock_guard<std::mutex> lock(job->mutex);
+  if (--job->remaining == 0)
+    job->done.notify_all();
+}
@@ -0,0 +1,106 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One process wide set of worker threads, started once and shared by the
+// engine, import and rendering preparation. Every worker takes tasks from the
+// back of its own queue and, when that is empty, steals from the front of the
+// others'. The thread calling run() works on queued tasks as well until its
+// own are done, so calls may nest. Low priority tasks, used to prepare plots
+// and GPU buffers, only run when no normal task is waiting.
+//
+// With NUMA placement the workers are spread evenly over the memory nodes.
+// runOn() then sends tasks to one worker and nobody else runs them, so data
+// a worker first touched is processed on its node later (see parallelHome()).
+class ThreadPool
+{
+public:
+  enum Priority {Normal, Low};
+
+  static ThreadPool& instance();
+
+  // Total threads including the calling one, 0 for one per core. Pinning puts
+  // worker i on core i + 1 and leaves core 0 to the GUI thread. With numa
+  // every worker is bound to its node's cores, and to one of them when pinned
+  // as well. Restarts a running pool, so only call it while nothing is queued.
+  static void configure(int threads, bool pinThreads = false,
+                        bool numa = false);
+
+  int threadCount() const { return int(workers_.size()) + 1; };
+  int workerCount() const { return int(workers_.size()); };
+  bool numaAware() const { return numa_; };
+  int nodeCount() const { return int(nodeCpus_.size()); };
+  int workerNode(int worker) const { return workers_[worker]->node; };
+
+  // Runs task(0) ... task(count - 1) and returns when all of them are done
+  void run(int count, const std::function<void(int)>& task,
+           Priority priority = Normal);
+  // Same, but task(i) runs on worker(i) and is never stolen. The worker takes
+  // its home tasks before any other, also while it waits inside a nested
+  // run(), so a home task may start in the middle of another task's loop.
+  void runOn(int count, const std::function<int(int)>& worker,
+             const std::function<void(int)>& task);
+
+  ~ThreadPool();
+
+private:
+  struct Job
+  {
+    const std::function<void(int)>* task;
+    std::atomic<int> remaining;
+    std::mutex mutex;
+    std::condition_variable done;
+  };
+
+  struct Task
+  {
+    Job* job;
+    int index;
+  };
+
+  // Queue index of the tasks only the owning worker takes
+  static const int HomeQueue = 2;
+
+  struct Worker
+  {
+    std::mutex mutex;
+    std::deque<Task> queues[3];
+    std::atomic<int> homeQueued;
+    int node;
+    std::thread thread;
+  };
+
+  ThreadPool();
+  void start(int threads, bool pinThreads, bool numa);
+  void stop();
+  void workerLoop(int self);
+  bool take(int self, Priority lowest, Task& task);
+  void execute(const Task& task);
+  void wait(Job& job, int self, Priority lowest);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::mutex sleepMutex_;
+  std::condition_variable wake_;
+  std::atomic<int> queued_;
+  std::atomic<quint32> nextWorker_;
+  bool stopping_;
+  bool numa_;
+  // Cores of each memory node, one node with all cores where unknown
+  std::vector<std::vector<int>> nodeCpus_;
+
+  static int configuredThreads_;
+  static bool configuredPinning_;
+  static bool configuredNuma_;
+  static std::atomic<bool> created_;
+};
+
+#endif // THREADPOOL_H
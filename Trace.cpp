@@ -0,0 +1,152 @@
+#include "Trace.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+std::atomic<bool> Trace::enabled_(false);
+
+namespace
+{
+  QMutex registryMutex;
+  std::vector<std::unique_ptr<TraceBuffer>> registry;
+  thread_local TraceBuffer* localBuffer = nullptr;
+  const auto epoch = std::chrono::steady_clock::now();
+}
+
+TraceBuffer::TraceBuffer(quint32 tid)
+  : tid_(tid), slots_(new Slot[Capacity]), head_(0), cleared_(0)
+{
+  for (quint32 i = 0; i < Capacity; i++)
+    slots_[i].sequence.store(0, std::memory_order_relaxed);
+}
+
+void TraceBuffer::push(const TraceEvent& event)
+{
+  // Single writer: only the owning thread pushes. The slot is marked as being
+  // written before its fields change, like a seqlock.
+  quint64 head = head_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[head & (Capacity - 1)];
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(event.name, std::memory_order_relaxed);
+  slot.category.store(event.category, std::memory_order_relaxed);
+  slot.startNs.store(event.startNs, std::memory_order_relaxed);
+  slot.durationNs.store(event.durationNs, std::memory_order_relaxed);
+  slot.sequence.store(head + 1, std::memory_order_release);
+  head_.store(head + 1, std::memory_order_release);
+}
+
+// Slots overwritten while they are copied are left out, so a snapshot taken
+// while the thread records never holds a torn event.
+QVector<TraceEvent> TraceBuffer::snapshot() const
+{
+  quint64 head = head_.load(std::memory_order_acquire);
+  quint64 first = qMax(head > Capacity ? head - Capacity : 0,
+                       cleared_.load(std::memory_order_acquire));
+  QVector<TraceEvent> events;
+  events.reserve(int(head > first ? head - first : 0));
+  for (quint64 i = first; i < head; i++)
+  {
+    const Slot& slot = slots_[i & (Capacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != i + 1)
+      continue;
+    TraceEvent event;
+    event.name = slot.name.load(std::memory_order_relaxed);
+    event.category = slot.category.load(std::memory_order_relaxed);
+    event.startNs = slot.startNs.load(std::memory_order_relaxed);
+    event.durationNs = slot.durationNs.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == i + 1)
+      events.append(event);
+  }
+  return events;
+}
+
+// Hides the events recorded so far. head_ belongs to the writer, so only the
+// first index a snapshot reads moves.
+void TraceBuffer::clear()
+{
+  cleared_.store(head_.load(std::memory_order_acquire),
+                 std::memory_order_release);
+}
+
+void Trace::setEnabled(bool flag)
+{
+  if (flag && !isEnabled())
+    clear();
+  enabled_.store(flag, std::memory_order_relaxed);
+}
+
+qint64 Trace::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::record(const char* name, const char* category,
+                   qint64 startNs, qint64 endNs)
+{
+  TraceEvent event;
+  event.name = name;
+  event.category = category;
+  event.startNs = startNs;
+  event.durationNs = endNs - startNs;
+  threadBuffer()->push(event);
+}
+
+TraceBuffer* Trace::threadBuffer()
+{
+  if (localBuffer == nullptr)
+  {
+    QMutexLocker lock(&registryMutex);
+    registry.emplace_back(new TraceBuffer(quint32(registry.size()) + 1));
+    localBuffer = registry.back().get();
+  }
+  return localBuffer;
+}
+
+void Trace::clear()
+{
+  QMutexLocker lock(&registryMutex);
+  for (auto& buffer : registry)
+    buffer->clear();
+}
+
+bool Trace::exportChromeJson(const QString& filename)
+{
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    return false;
+
+  QTextStream out(&file);
+  out << "{\"traceEvents\":[\n";
+  bool first = true;
+
+  QMutexLocker lock(&registryMutex);
+  for (auto& buffer : registry)
+  {
+    if (!first) out << ",\n";
+    first = false;
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+        << buffer->tid() << ",\"args\":{\"name\":\"thread "
+        << buffer->tid() << "\"}}";
+
+    QVector<TraceEvent> events = buffer->snapshot();
+    for (const TraceEvent& e : events)
+    {
+      // Timestamps are in microseconds
+      out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+          << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid()
+          << ",\"ts\":" << QString::number(e.startNs / 1000.0, 'f', 3)
+          << ",\"dur\":" << QString::number(e.durationNs / 1000.0, 'f', 3)
+          << "}";
+    }
+  }
+  out << "\n]}\n";
+  file.close();
+  return true;
+}
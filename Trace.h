@@ -0,0 +1,91 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+// Opt-in timeline tracing. Each thread records completed spans into its own
+// fixed size ring buffer, so recording never takes a lock. The buffers can be
+// exported as Chrome trace JSON and opened in chrome://tracing or Perfetto.
+
+struct TraceEvent
+{
+  const char* name = nullptr;
+  const char* category = nullptr;
+  qint64 startNs = 0;
+  qint64 durationNs = 0;
+};
+
+class TraceBuffer
+{
+public:
+  static const quint32 Capacity = 1 << 16;
+
+  explicit TraceBuffer(quint32 tid);
+
+  void push(const TraceEvent& event);
+  QVector<TraceEvent> snapshot() const;
+  void clear();
+  quint32 tid() const { return tid_; };
+
+private:
+  // sequence is the event's index + 1 once the event is complete and 0 while
+  // it is being written, so readers can skip slots the writer is reusing
+  struct Slot
+  {
+    std::atomic<quint64> sequence;
+    std::atomic<const char*> name;
+    std::atomic<const char*> category;
+    std::atomic<qint64> startNs;
+    std::atomic<qint64> durationNs;
+  };
+
+  quint32 tid_;
+  std::unique_ptr<Slot[]> slots_;
+  // Only the owning thread writes head_, only readers write cleared_
+  std::atomic<quint64> head_;
+  std::atomic<quint64> cleared_;
+};
+
+class Trace
+{
+public:
+  static void setEnabled(bool flag);
+  static bool isEnabled() { return enabled_.load(std::memory_order_relaxed); };
+  static qint64 now();
+  static void record(const char* name, const char* category,
+                     qint64 startNs, qint64 endNs);
+  static bool exportChromeJson(const QString& filename);
+  static void clear();
+
+private:
+  static TraceBuffer* threadBuffer();
+  static std::atomic<bool> enabled_;
+};
+
+class TraceScope
+{
+public:
+  TraceScope(const char* name, const char* category)
+    : name_(name), category_(category),
+      startNs_(Trace::isEnabled() ? Trace::now() : -1) {}
+  ~TraceScope()
+  {
+    if (startNs_ >= 0)
+      Trace::record(name_, category_, startNs_, Trace::now());
+  }
+
+private:
+  const char* name_;
+  const char* category_;
+  qint64 startNs_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name, category) \
+  TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name, category)
+
+#endif // TRACE_H
@@ -0,0 +1,42 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// Single producer, single consumer triple buffer. The producer fills back()
+// and calls publish(); the consumer calls update() and reads front(). Neither
+// side blocks, and the consumer only ever sees the most recently published
+// slot, intermediate ones are dropped.
+template <class T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() : back_(0), middle_(1), front_(2) {}
+
+  T& back() { return slots_[back_]; }
+  void publish()
+  {
+    back_ = middle_.exchange(back_ | DirtyBit, std::memory_order_acq_rel) &
+            IndexMask;
+  }
+
+  bool update()
+  {
+    if (!(middle_.load(std::memory_order_acquire) & DirtyBit))
+      return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & IndexMask;
+    return true;
+  }
+  T& front() { return slots_[front_]; }
+
+private:
+  static const int DirtyBit = 4;
+  static const int IndexMask = 3;
+
+  T slots_[3];
+  int back_;
+  std::atomic<int> middle_;
+  int front_;
+};
+
+#endif // TRIPLEBUFFER_H
@@ -3,16 +3,28 @@
 ViewWidget::ViewWidget(QWidget *parent, Qt::WindowFlags f) :
   QOpenGLWidget(parent, f)
 {
-  m_center = {0, 0, 25};
-  m_eye = {0, 0, 0};
+  // lookAt() takes m_center as the eye and m_eye as the target
+  m_center = PointRenderer::DefaultEye;
+  m_eye = PointRenderer::DefaultTarget;
   m_previousSet = false;
-  m_pointSize = 4.0f;
   m_rotate = false;
   m_lastRotation = 0.0f;
   m_currentRotation = 0.0f;
+  m_maxRotationFps = 60;
+  m_frameMs = 0.0f;
+  m_fps = 0.0f;
+
+  m_turntableTimer.setTimerType(Qt::PreciseTimer);
+  connect(&m_turntableTimer, &QTimer::timeout, this, [this]() { update(); });
 
   m_elapsedTimer.start();
-  m_fpsTimer.start();
+}
+
+ViewWidget::~ViewWidget()
+{
+  makeCurrent();
+  m_renderer.destroy();
+  doneCurrent();
 }
 
 void ViewWidget::initializeGL()
@@ -23,12 +35,8 @@ void ViewWidget::initializeGL()
   glClearColor(0.25, 0.25, 0.25, 1.0);
 
   glEnable(GL_DEPTH_TEST);
-  glEnable(GL_PROGRAM_POINT_SIZE);
-  glEnable(GL_POINT_SMOOTH);
 
-  m_pointProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, vertexCode);
-  m_pointProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, fragCode);
-  m_pointProgram.link();
+  m_renderer.initialize();
 }
 
 QVector<GLfloat> ViewWidget::createPolygon(float x, float y, float z, float radius,
@@ -58,38 +66,41 @@ float ViewWidget::angleForTime(qint64 msTime, float secondsPerRotation) const
   return (t - qFloor(t)) * 360.0;
 }
 
-void ViewWidget::setPointColors(QVector<float> colors)
+void ViewWidget::setPalette(const QVector<QColor>& colors)
+{
+  m_renderer.setPalette(colors);
+  update();
+}
+
+void ViewWidget::setPointClusters(const QVector<quint32>& clusters)
 {
-  m_pointColors.clear();
-  m_pointColors = colors;
+  m_renderer.setPointClusters(clusters);
+  update();
 }
 
-void ViewWidget::setCentroidColors(QVector<float> colors)
+void ViewWidget::setPointCluster(int index, quint32 cluster)
 {
-  m_centroidColors.clear();
-  m_centroidColors = colors;
+  // A frame is already pending after the first change
+  if (m_renderer.setPointCluster(index, cluster))
+    update();
 }
 
-void ViewWidget::setPoints(QVector<double> xPoints, QVector<double> yPoints, QVector<double> zPoints)
+void ViewWidget::setPoints(const DatasetPtr& dataset)
 {
-  m_points.clear();
-  for (int i = 0; i < xPoints.size(); i++)
-  {
-    m_points.append(xPoints[i]);
-    m_points.append(yPoints[i]);
-    m_points.append(zPoints[i]);
-  }
+  m_renderer.setPoints(dataset);
+  update();
 }
 
 void ViewWidget::setPointSize(float pointsize)
 {
-  m_pointSize = pointsize;
+  m_renderer.setPointSize(pointsize);
+  update();
 }
 
-void ViewWidget::setCentroidPoints(QVector<float> centroids)
+void ViewWidget::setCentroidPoints(const QVector<float>& centroids)
 {
-  m_centroids.clear();
-  m_centroids = centroids;
+  m_renderer.setCentroidPoints(centroids);
+  update();
 }
 
 void ViewWidget::switchRotate()
@@ -97,23 +108,35 @@ void ViewWidget::switchRotate()
   m_rotate = !m_rotate;
   if(!m_rotate)
     m_lastRotation = m_currentRotation;
+
+  if (m_rotate)
+  {
+    m_turntableTimer.start(m_maxRotationFps > 0 ? 1000 / m_maxRotationFps : 0);
+    m_intervalTimer.invalidate();
+  }
+  else
+    m_turntableTimer.stop();
+  update();
 }
 
-void ViewWidget::reset()
+void ViewWidget::setPointBudget(int points)
 {
-  m_previousSet = false;
-  m_pointSize = 4.0f;
+  m_renderer.setPointBudget(points);
+  update();
+}
 
-  m_centroids.clear();
-  m_centroidColors.clear();
-  m_pointColors.clear();
-  for (int i = 0; i < m_points.size(); i++)
-  {
-    m_pointColors.append(0.0f);
-    m_pointColors.append(1.0f);
-    m_pointColors.append(1.0f);
-  }
+void ViewWidget::setMaxRotationFps(int fps)
+{
+  m_maxRotationFps = fps;
+  if (m_rotate)
+    m_turntableTimer.start(m_maxRotationFps > 0 ? 1000 / m_maxRotationFps : 0);
+}
 
+void ViewWidget::reset()
+{
+  m_previousSet = false;
+  m_renderer.reset();
+  update();
 }
 
 void ViewWidget::moveEye(float x, float y, float z)
@@ -121,50 +144,48 @@ void ViewWidget::moveEye(float x, float y, float z)
   m_eye.setX(m_eye.x() - x);
   m_eye.setY(m_eye.y() + y);
   m_eye.setZ(m_eye.z() + z);
+  update();
 }
 
 void ViewWidget::paintGL()
 {
+  TRACE_SCOPE("paintGL", "render");
+  m_frameTimer.start();
   glEnable(GL_DEPTH_TEST);
 
-  QMatrix4x4 pmvMatrix;
-  pmvMatrix.perspective(40.0, float(width())/height(), 1.0f, 2000.0f);
-  pmvMatrix.lookAt(m_center, m_eye, {0, 1, 0});
+  QMatrix4x4 projection = PointRenderer::projection(size());
+  QMatrix4x4 modelView = PointRenderer::lookAt(m_center, m_eye);
   if (m_rotate)
-    pmvMatrix.rotate(angleForTime(m_elapsedTimer.elapsed(),15),
+    modelView.rotate(angleForTime(m_elapsedTimer.elapsed(),15),
                      {0.0f, 1.0f, 0.0f});
 
-  m_pointProgram.bind();
-  m_pointProgram.enableAttributeArray("vertex");
-  m_pointProgram.enableAttributeArray("color");
-
-  m_pointProgram.setUniformValue("matrix", pmvMatrix);
-  m_pointProgram.setAttributeArray("vertex", m_points.constData(), 3);
-  m_pointProgram.setAttributeArray("color", m_pointColors.constData(), 3);
-
-  glPointSize(m_pointSize);
-  glDrawArrays(GL_POINTS, 0, m_points.count()/3);
-
-  m_pointProgram.disableAttributeArray("vertex");
-  m_pointProgram.enableAttributeArray("vertex");
-  m_pointProgram.setAttributeArray("vertex", m_centroids.constData(), 3);
-  m_pointProgram.setAttributeArray("color", m_centroidColors.constData(), 3);
-  glPointSize(m_pointSize + 20.0f);
-  glDrawArrays(GL_POINTS, 0, m_centroids.count()/3);
-  m_pointProgram.disableAttributeArray("vertex");
+  m_renderer.upload();
+  if (m_renderer.render(projection, modelView, m_rotate))
+    QTimer::singleShot(0, this, [this]() { update(); });
 
+  // Shows the previous frame's CPU time, and the rate frames actually
+  // arrive at while the turntable runs
+  QString frameText = QString::number(m_frameMs, 'f', 2) + QString(" ms");
+  if (m_rotate)
+    frameText += QString(", ") + QString::number(m_fps, 'G', 4) +
+                 QString(" FPS");
   QPainter painter(this);
-  painter.drawText(QRect(0, height() - 20, width(), 20),
-                   QString::number(m_fps, 'G', 4) + QString(" FPS"));
-
-  m_frameCount++;
+  painter.drawText(QRect(0, height() - 20, width(), 20), frameText);
+  painter.end();
 
-  if (m_fpsTimer.elapsed() > 500)
+  m_frameMs = m_frameTimer.nsecsElapsed() / 1.0e6f;
+  if (m_rotate && m_intervalTimer.isValid())
   {
-    m_fps = float(m_frameCount) / m_fpsTimer.restart() * 1000.0f;
-    m_frameCount = 0;
+    float interval = m_intervalTimer.restart();
+    if (interval > 0)
+      m_fps = m_fps > 0 ? 0.9f * m_fps + 0.1f * (1000.0f / interval)
+                        : 1000.0f / interval;
+  }
+  else
+  {
+    m_intervalTimer.start();
+    m_fps = 0.0f;
   }
-  update();
 }
 
 void ViewWidget::wheelEvent(QWheelEvent *event)
@@ -175,9 +196,5 @@ void ViewWidget::wheelEvent(QWheelEvent *event)
     m_center.setZ(m_center.z() - 1.00f);
   else
     m_center.setZ(m_center.z() + 1.00f);
+  update();
 }
-
-//void ViewWidget::updateTurntable()
-//{
-//  update();
-//}
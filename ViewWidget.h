@@ -13,6 +13,8 @@
 #include <QColor>
 #include <QDebug>
 #include <QWheelEvent>
+#include "Trace.h"
+#include "PointRenderer.h"
 
 class ViewWidget : public QOpenGLWidget, protected QOpenGLFunctions
 {
@@ -20,19 +22,22 @@ class ViewWidget : public QOpenGLWidget, protected QOpenGLFunctions
 
 public:
   ViewWidget(QWidget *parent = nullptr, Qt::WindowFlags f = Qt::WindowFlags());
+  ~ViewWidget();
   QVector<GLfloat> createPolygon(float x, float y, float z, float radius,
                                  int sides);
   float angleForTime(qint64 msTime, float secondsPerRotation) const;
 
   void zoom();
   QVector3D getEye() { return m_eye; };
-  void setPointColors(QVector<float> colors);
-  void setCentroidColors(QVector<float> colors);
-  void setPoints(QVector<double> xPoints, QVector<double> yPoints,
-                 QVector<double> zPoints);
+  void setPalette(const QVector<QColor>& colors);
+  void setPointClusters(const QVector<quint32>& clusters);
+  void setPointCluster(int index, quint32 cluster);
+  void setPoints(const DatasetPtr& dataset);
   void setPointSize(float pointsize);
-  void setCentroidPoints(QVector<float> centroids);
+  void setCentroidPoints(const QVector<float>& centroids);
   void switchRotate();
+  void setMaxRotationFps(int fps);
+  void setPointBudget(int points);
   void reset();
   void moveEye(float x, float y, float z);
 //  void setPoints(QVector)
@@ -42,15 +47,10 @@ protected:
   void paintGL() override;
   void wheelEvent(QWheelEvent* event) override;
 
-//private slots:
-//  void updateTurntable();
 
 private:
   float m_turntableAngle = 0.0f;
-  float m_pointSize = 0.0f;
-  QVector<float> m_points, m_centroids;
-  QVector<float> m_pointColors, m_centroidColors;
-  QOpenGLShaderProgram m_pointProgram;
+  PointRenderer m_renderer;
   QOpenGLShaderProgram m_axesProgram;
   QElapsedTimer m_elapsedTimer;
   qint64 m_lastTime;
@@ -61,25 +61,15 @@ private:
   bool m_rotate;
   float m_currentRotation, m_lastRotation;
 
-  QElapsedTimer m_fpsTimer;
-  int m_frameCount;
+  // Frames are only drawn on change; while rotating the turntable timer
+  // requests them at up to m_maxRotationFps (0 is uncapped)
+  QTimer m_turntableTimer;
+  int m_maxRotationFps;
+  QElapsedTimer m_frameTimer;
+  QElapsedTimer m_intervalTimer;
+  float m_frameMs;
   float m_fps;
-  const char* vertexCode =
-    "attribute highp vec4 vertex;\n"
-    "attribute mediump vec4 color;\n"
-    "varying mediump vec4 vColor;\n"
-    "uniform highp mat4 matrix;\n"
-    "void main(void)\n"
-    "{\n"
-    "   gl_Position = matrix * vertex;\n"
-    "   vColor = color;\n"
-    "}";
-  const char* fragCode =
-    "varying mediump vec4 vColor;\n"
-    "void main(void)\n"
-    "{\n"
-    "   gl_FragColor = vColor;\n"
-    "}";
+
 };
 
 #endif // VIEWWIDGET_H
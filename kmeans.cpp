@@ -16,27 +16,45 @@ kmeans<T>::kmeans(int k, quint32 maxIterations)
   randomCentroidsInitialized_ = false;
   stopReason = "";
   ignoreSame_ = false;
-
-  rand_ = QRandomGenerator::global();
+  statsEnabled_ = false;
+  sumsValid_ = false;
+  assignmentsValid_ = false;
+  fullUpdateInterval_ = 32;
+  columns_ = nullptr;
+  weights_ = nullptr;
+  size_ = 0;
+  seed_ = 0;
+  threads_ = 0;
+  refine_ = false;
 }
 
 template <class T>
-kmeans<T>::kmeans(int k, QVector<T> data, quint32 maxIterations)
+kmeans<T>::kmeans(int k, DatasetPtr data, quint32 maxIterations)
 {
   initialized_ = false;
   maxIterations_ = maxIterations;
   currIteration_ = 0;
   k_ = k;
   data_ = data;
+  columns_ = data_.isNull() ? nullptr : data_->columnData();
+  weights_ = data_.isNull() ? nullptr : data_->weights();
+  size_ = data_.isNull() ? 0 : data_->size();
   initType_ = InitializeType::Sample;
   energy_ = 0.0;
   randomCentroidsInitialized_ = false;
   stopReason = "";
   ignoreSame_ = false;
+  statsEnabled_ = false;
+  sumsValid_ = false;
+  assignmentsValid_ = false;
+  fullUpdateInterval_ = 32;
+
+  seed_ = 0;
+  threads_ = 0;
+  refine_ = false;
 
   centroids_.resize(k_);
-  assignments_.resize(data_.size());
-  rand_ = QRandomGenerator::global();
+  assignments_.resize(size_);
 }
 
 template <class T>
@@ -45,6 +63,42 @@ void kmeans<T>::setInitialization(InitializeType type)
   initType_ = type;
 }
 
+// Seed for Sample and Kpp initialization. Takes effect at the next
+// initialization, i.e. after reset().
+template <class T>
+void kmeans<T>::setSeed(quint64 seed)
+{
+  seed_ = seed;
+}
+
+// Upper bound on the threads used per step, 0 for all cores; NUMA placement
+// always uses every worker. Only changes the speed, never the result.
+template <class T>
+void kmeans<T>::setThreads(int threads)
+{
+  threads_ = threads;
+}
+
+// reduced stands in for the data, e.g. grid cells or a coreset: the first
+// step clusters it with the chosen initialization to convergence and assigns
+// the full data to the centroids found. The run stops there unless refine is
+// set, then Lloyd steps on the full data follow. A null reduced clears it.
+//
+// representative, when given, holds the row of reduced standing in for each
+// point. For a metric d every point's distance to a set of centroids then
+// changes by at most its distance to its representative, so the energy of
+// any centroids on the full data is within the sum of those distances of
+// their energy on the reduced data. That sum is reported as
+// KMeansStats::reductionBound.
+template <class T>
+void kmeans<T>::setReduction(DatasetPtr reduced,
+                             QVector<quint32> representative, bool refine)
+{
+  reduced_ = reduced;
+  representative_ = representative;
+  refine_ = refine;
+}
+
 template<class T>
 void kmeans<T>::setRandomCentroids(QVector<T> centroids)
 {
@@ -58,11 +112,35 @@ void kmeans<T>::setIgnoreSameAssignments(bool flag)
   ignoreSame_ = flag;
 }
 
+template<class T>
+void kmeans<T>::setStatsEnabled(bool flag)
+{
+  statsEnabled_ = flag;
+  stats_ = KMeansStats();
+}
+
+template<class T>
+void kmeans<T>::setStatsCallback(std::function<void(const KMeansStats&)> callback)
+{
+  statsCallback_ = callback;
+}
+
+template<class T>
+void kmeans<T>::setFullUpdateInterval(int iterations)
+{
+  fullUpdateInterval_ = iterations;
+}
+
 template <class T>
-void kmeans<T>::setData(QVector<T> data)
+void kmeans<T>::setData(DatasetPtr data)
 {
   data_ = data;
-  assignments_.resize(data_.size());
+  columns_ = data_.isNull() ? nullptr : data_->columnData();
+  weights_ = data_.isNull() ? nullptr : data_->weights();
+  size_ = data_.isNull() ? 0 : data_->size();
+  assignments_.resize(size_);
+  sumsValid_ = false;
+  assignmentsValid_ = false;
 }
 
 template<class T>
@@ -76,19 +154,39 @@ void kmeans<T>::setK(int k)
 template <class T>
 bool kmeans<T>::step(std::function<double(T, T)> d)
 {
+  // A step that returns early leaves an empty delta behind
+  delta_.iteration = currIteration_;
+  delta_.full = false;
+  delta_.changes.clear();
+  delta_.movedCentroids.clear();
+
   if (!stopReason.isEmpty())
     return false;
 
+  TRACE_SCOPE("step", "kmeans");
   bool sameAssignments = true;
+  QElapsedTimer phaseTimer;
+  if (statsEnabled_)
+  {
+    stats_ = KMeansStats();
+    stats_.iteration = currIteration_ + 1;
+    phaseTimer.start();
+  }
+
   // Random assignment of centroids to data
+  bool reducedInit = false;
   if (!initialized_)
   {
+    TRACE_SCOPE("init", "kmeans");
     initialized_ = true;
+    reducedInit = !reduced_.isNull();
     if (!initialize(d))
     {
       stopReason = "Not initialized.";
       return false;
     }
+    if (statsEnabled_)
+      stats_.initNs = phaseTimer.nsecsElapsed();
   }
   if (currIteration_ >= maxIterations_)
   {
@@ -96,40 +194,134 @@ bool kmeans<T>::step(std::function<double(T, T)> d)
     return false;
   }
   energy_ = 0.0;
+  if (statsEnabled_)
+    phaseTimer.start();
+
+  // Cluster sums are kept between steps and only corrected for reassigned
+  // points. A periodic full rebuild bounds floating point drift.
+  bool fullUpdate = !sumsValid_ || fullUpdateInterval_ <= 1 ||
+                    currIteration_ % fullUpdateInterval_ == 0;
+  if (fullUpdate)
+  {
+    sums_.fill(T(), k_);
+    counts_.fill(0, k_);
+    if (weights_)
+      weightSums_.fill(0.0, k_);
+  }
 
-  // Assign cluster centers
-  T newCentroids[k_] = {};
-  quint32 cCount[k_] = {};
+  delta_.iteration = currIteration_ + 1;
+  delta_.full = !assignmentsValid_;
+
+  // Assign cluster centers. Each leaf collects its energy and its sums, or
+  // only the corrections for its reassigned points, on one thread.
+  const int leaves = leafCount();
+  const qint32 leafSize = this->leafSize();
+  leafSums_.fill(T(), leaves * k_);
+  leafCounts_.fill(0, leaves * k_);
+  if (weights_)
+    leafWeights_.fill(0.0, leaves * k_);
+  leafEnergy_.fill(0.0, leaves);
+  leafReassigned_.fill(0, leaves);
+  leafChanges_.resize(leaves);
+  int threadsUsed;
+  {
+    TRACE_SCOPE("assign", "kmeans");
+    LeafPass pass;
+    pass.centroids = centroids_.constData();
+    pass.k = centroids_.size();
+    pass.leafSize = leafSize;
+    pass.fullUpdate = fullUpdate;
+    pass.recordChanges = !delta_.full;
+    pass.assignments = assignments_.data();
+    pass.sums = leafSums_.data();
+    pass.counts = leafCounts_.data();
+    pass.weights = weights_ ? leafWeights_.data() : nullptr;
+    pass.energy = leafEnergy_.data();
+    pass.reassigned = leafReassigned_.data();
+    pass.changes = leafChanges_.data();
+
+    if (weights_)
+      threadsUsed = forLeaves(leaves, [&](qint64 firstLeaf, qint64 lastLeaf)
+      {
+        for (qint64 leaf = firstLeaf; leaf < lastLeaf; leaf++)
+          assignLeaf<true>(pass, leaf, d);
+      });
+    else
+      threadsUsed = forLeaves(leaves, [&](qint64 firstLeaf, qint64 lastLeaf)
+      {
+        for (qint64 leaf = firstLeaf; leaf < lastLeaf; leaf++)
+          assignLeaf<false>(pass, leaf, d);
+      });
+  }
 
-  quint32 assignedC;
-  double currentD, minD;
-  for (qint32 p = 0; p < data_.size(); p++)
+  quint32 reassigned = 0;
+  for (int leaf = 0; leaf < leaves; leaf++)
+  {
+    reassigned += leafReassigned_[leaf];
+    if (!delta_.full)
+      delta_.changes += leafChanges_[leaf];
+  }
+  sameAssignments = reassigned == 0;
+  if (leaves > 0)
   {
-    minD = d(data_[p], centroids_[0]);
-    assignedC = 0;
-    for (qint32 c = 1; c < centroids_.size(); c++)
+    reduceLeaves(leaves);
+    energy_ = leafEnergy_[0];
+    for (int c = 0; c < k_; c++)
     {
-      currentD = d(data_[p], centroids_[c]);
-      if (currentD < minD)
-      {
-        currentD = minD;
-        assignedC = c;
-      }
+      sums_[c] += leafSums_[c];
+      counts_[c] += leafCounts_[c];
+      if (weights_)
+        weightSums_[c] += leafWeights_[c];
     }
-    energy_ += minD;
-    if (assignments_[p] != assignedC)
-      sameAssignments = false;
-    assignments_[p] = assignedC;
+  }
+  sumsValid_ = true;
+  assignmentsValid_ = true;
 
-    newCentroids[assignedC] += data_[p];
-    cCount[assignedC]++;
+  if (statsEnabled_)
+  {
+    stats_.assignNs = phaseTimer.nsecsElapsed();
+    stats_.distanceEvaluations = quint64(size_) * centroids_.size();
+    stats_.pointsReassigned = reassigned;
+    stats_.threadsUsed = threadsUsed;
+    phaseTimer.start();
   }
 
   // Calculate new cluster centers
-  for (qint32 i = 0; i < k_; i++)
-    if (cCount[i] != 0)
-      centroids_[i] = newCentroids[i] / cCount[i];
+  {
+    TRACE_SCOPE("update", "kmeans");
+    for (qint32 i = 0; i < k_; i++)
+    {
+      // Points of zero weight don't give a cluster a mean
+      if (counts_[i] != 0 && (!weights_ || weightSums_[i] > 0.0))
+      {
+        T updated = weights_ ? sums_[i] / weightSums_[i]
+                             : sums_[i] / counts_[i];
+        double shift = d(centroids_[i], updated);
+        if (shift != 0.0)
+          delta_.movedCentroids.append(i);
+        if (statsEnabled_)
+          stats_.maxCentroidShift = qMax(stats_.maxCentroidShift, shift);
+        centroids_[i] = updated;
+      }
+      else if (statsEnabled_)
+        stats_.emptyClusters++;
+    }
+  }
   currIteration_++;
+
+  if (statsEnabled_)
+  {
+    stats_.updateNs = phaseTimer.nsecsElapsed();
+    if (statsCallback_)
+      statsCallback_(stats_);
+  }
+
+  if (reducedInit && !refine_)
+  {
+    stopReason = "Assigned after clustering reduced data.";
+    return false;
+  }
+
   if (sameAssignments && !ignoreSame_)
   {
     stopReason = "Assignments didn't change.";
@@ -162,12 +354,30 @@ template<class T>
 void kmeans<T>::reset()
 {
   centroids_.resize(k_);
-  assignments_.resize(data_.size());
+  assignments_.resize(size_);
   initialized_ = false;
   randomCentroidsInitialized_ = false;
   energy_ = 0.0;
   stopReason = "";
   currIteration_ = 0;
+  sumsValid_ = false;
+  assignmentsValid_ = false;
+}
+
+// Puts the engine back to the state after the given iteration, e.g. from an
+// undo history, so the next step continues from there.
+template<class T>
+void kmeans<T>::restoreState(quint32 iteration, QVector<T> centroids,
+                             QVector<quint32> assignments, double energy)
+{
+  centroids_ = centroids;
+  assignments_ = assignments;
+  currIteration_ = iteration;
+  energy_ = energy;
+  stopReason = "";
+  initialized_ = true;
+  sumsValid_ = false;
+  assignmentsValid_ = true;
 }
 
 template<class T>
@@ -176,6 +386,12 @@ int kmeans<T>::k() const
   return k_;
 }
 
+template<class T>
+quint32 kmeans<T>::iteration() const
+{
+  return currIteration_;
+}
+
 template<class T>
 QVector<T> &kmeans<T>::centroids()
 {
@@ -188,6 +404,25 @@ QVector<quint32> &kmeans<T>::assignments()
   return assignments_;
 }
 
+// Cluster of every row of the data set: the point's cluster, or with
+// collapsed duplicates the cluster of the row's point
+template<class T>
+QVector<quint32> kmeans<T>::rowAssignments() const
+{
+  if (data_.isNull() || data_->rowIndex().isEmpty())
+    return assignments_;
+  const quint32* index = data_->rowIndex().constData();
+  const quint32* assigned = assignments_.constData();
+  QVector<quint32> rows(data_->rowCount());
+  quint32* row = rows.data();
+  parallelFor(rows.size(), MinLeafSize, [=](qint64 begin, qint64 end)
+  {
+    for (qint64 i = begin; i < end; i++)
+      row[i] = assigned[index[i]];
+  });
+  return rows;
+}
+
 template <class T>
 kmeans<T>::~kmeans()
 {}
@@ -195,6 +430,8 @@ kmeans<T>::~kmeans()
 template<class T>
 bool kmeans<T>::initialize(std::function<double(T, T)> d)
 {
+  if (!reduced_.isNull())
+    return initializeReduced(d);
   switch (initType_)
   {
     case InitializeType::Random: return checkRandomCentroids(); break;
@@ -210,64 +447,325 @@ bool kmeans<T>::checkRandomCentroids()
   return randomCentroidsInitialized_;
 }
 
+template<class T>
+qint32 kmeans<T>::leafSize() const
+{
+  return qMax(qint32(MinLeafSize), (size_ + MaxLeaves - 1) / MaxLeaves);
+}
+
+template<class T>
+int kmeans<T>::leafCount() const
+{
+  return (size_ + leafSize() - 1) / leafSize();
+}
+
+// One leaf of the assign phase: energy and sums of its points, or only the
+// corrections for its reassigned points
+template<class T>
+template<bool Weighted>
+void kmeans<T>::assignLeaf(const LeafPass& pass, qint64 leaf,
+                           const std::function<double(T, T)>& d) const
+{
+  T* leafSums = pass.sums + leaf * pass.k;
+  qint32* leafCounts = pass.counts + leaf * pass.k;
+  double* leafWeights = Weighted ? pass.weights + leaf * pass.k : nullptr;
+  double leafEnergy = 0.0;
+  pass.changes[leaf].clear();
+  const qint32 end = qMin<qint64>(size_, (leaf + 1) * pass.leafSize);
+  for (qint32 p = qint32(leaf * pass.leafSize); p < end; p++)
+  {
+    const T x = point(p);
+    double minD = d(x, pass.centroids[0]);
+    quint32 assignedC = 0;
+    for (qint32 c = 1; c < pass.k; c++)
+    {
+      double currentD = d(x, pass.centroids[c]);
+      if (currentD < minD)
+      {
+        minD = currentD;
+        assignedC = c;
+      }
+    }
+    const double w = Weighted ? weights_[p] : 1.0;
+    const T wx = Weighted ? x * w : x;
+    leafEnergy += Weighted ? w * minD : minD;
+    quint32 previousC = pass.assignments[p];
+    if (previousC != assignedC)
+    {
+      pass.reassigned[leaf]++;
+      if (pass.recordChanges)
+        pass.changes[leaf].append({quint32(p), previousC, assignedC});
+      if (!pass.fullUpdate)
+      {
+        leafSums[previousC] -= wx;
+        leafCounts[previousC]--;
+        leafSums[assignedC] += wx;
+        leafCounts[assignedC]++;
+        if (Weighted)
+        {
+          leafWeights[previousC] -= w;
+          leafWeights[assignedC] += w;
+        }
+      }
+    }
+    pass.assignments[p] = assignedC;
+
+    if (pass.fullUpdate)
+    {
+      leafSums[assignedC] += wx;
+      leafCounts[assignedC]++;
+      if (Weighted)
+        leafWeights[assignedC] += w;
+    }
+  }
+  pass.energy[leaf] = leafEnergy;
+}
+
+// Runs f(firstLeaf, lastLeaf) over all leaves. With NUMA placement each leaf
+// goes to the worker whose node the data set put its points on.
+template<class T>
+template<class F>
+int kmeans<T>::forLeaves(int leaves, F f)
+{
+  if (ThreadPool::instance().numaAware())
+    return parallelHome(leaves, 1, f);
+  return parallelFor(leaves, 1, f, threads_);
+}
+
+// Adds leaf l + width into leaf l for widths 1, 2, 4, ... The tree only
+// depends on the number of leaves, not on which thread filled them. With
+// NUMA placement the owner of leaf l does the adding, so the lower levels
+// reduce within a node and only the top few levels cross nodes.
+template<class T>
+void kmeans<T>::reduceLeaves(int leaves)
+{
+  T* sums = leafSums_.data();
+  qint32* counts = leafCounts_.data();
+  double* weights = weights_ ? leafWeights_.data() : nullptr;
+  double* energy = leafEnergy_.data();
+  ThreadPool& pool = ThreadPool::instance();
+  const int workers = pool.workerCount();
+  for (int width = 1; width < leaves; width *= 2)
+  {
+    auto add = [&](int pair)
+    {
+      const int l = pair * 2 * width;
+      T* to = sums + l * k_;
+      const T* from = sums + (l + width) * k_;
+      for (int c = 0; c < k_; c++)
+      {
+        to[c] += from[c];
+        counts[l * k_ + c] += counts[(l + width) * k_ + c];
+      }
+      if (weights)
+        for (int c = 0; c < k_; c++)
+          weights[l * k_ + c] += weights[(l + width) * k_ + c];
+      energy[l] += energy[l + width];
+    };
+    const int pairs = (leaves + width - 1) / (2 * width);
+    if (pool.numaAware() && workers > 0)
+      pool.runOn(pairs, [&](int pair)
+                 { return int(qint64(pair) * 2 * width * workers / leaves); },
+                 add);
+    else
+      for (int pair = 0; pair < pairs; pair++)
+        add(pair);
+  }
+}
+
+// Uniform in [0, 1), a pure function of the seed, stream and index
+template<class T>
+double kmeans<T>::draw(quint32 stream, quint64 index) const
+{
+  return PhiloxDraws(seed_, stream, index).uniform();
+}
+
+// Running sums of the weights, empty for unweighted data
+template<class T>
+QVector<double> kmeans<T>::cumulativeWeights() const
+{
+  QVector<double> cumulative;
+  if (!weights_)
+    return cumulative;
+  cumulative.resize(size_);
+  double sum = 0.0;
+  for (qint32 i = 0; i < size_; i++)
+  {
+    sum += weights_[i];
+    cumulative[i] = sum;
+  }
+  return cumulative;
+}
+
+// Point for a draw u in [0, 1), uniform over the points or, given the
+// cumulative weights, over their weight
+template<class T>
+qint32 kmeans<T>::pickPoint(double u, const QVector<double>& cumulative) const
+{
+  if (cumulative.isEmpty())
+    return qMin(qint32(u * size_), size_ - 1);
+  const double* found = std::upper_bound(cumulative.constBegin(),
+                                         cumulative.constEnd(),
+                                         u * cumulative.last());
+  return qMin(qint32(found - cumulative.constBegin()), size_ - 1);
+}
+
 template<class T>
 bool kmeans<T>::initializeSample()
 {
-  std::generate(centroids_.begin(), centroids_.end(),
-              [this]() { return data_[rand_->bounded(data_.size())]; });
+  if (size_ == 0)
+    return false;
+  const QVector<double> cumulative = cumulativeWeights();
+  for (int c = 0; c < centroids_.size(); c++)
+    centroids_[c] = point(pickPoint(draw(RandomData::SampleStream, c),
+                                    cumulative));
   return true;
 }
 
 template<class T>
 bool kmeans<T>::initializeKpp(std::function<double(T, T)> d)
 {
-  QVector<double> distances(data_.size()), cdf(data_.size());
-  double currentDistance, minDistance, totalDistance;
-  double pick;
+  if (size_ == 0)
+    return false;
+
+  // Distance from each point to its nearest centroid so far, updated with
+  // the newest centroid only
+  QVector<double> distances(size_, std::numeric_limits<double>::max());
+  double* dist = distances.data();
+  const int leaves = leafCount();
+  const qint32 leafSize = this->leafSize();
+  QVector<double> leafTotals(leaves), tree(leaves);
+
+  // Share of a point in the pick, its distance times its weight
+  const double* weights = weights_;
+  auto share = [dist, weights](qint32 i)
+  {
+    return weights ? weights[i] * dist[i] : dist[i];
+  };
 
   // Initialize first centroid at random
-  centroids_[0] = data_[rand_->bounded(data_.size())];
+  centroids_[0] = point(pickPoint(draw(RandomData::KppStream, 0),
+                                  cumulativeWeights()));
 
   for (int c = 1; c < centroids_.size(); c++)
   {
-    totalDistance = 0.0;
-
-    // Find minimum distance between a point and all centroids
-    for (int i = 0; i < data_.size(); i++)
+    const T newest = centroids_[c - 1];
+    double* totals = leafTotals.data();
+    forLeaves(leaves, [&](qint64 firstLeaf, qint64 lastLeaf)
     {
-      minDistance = std::numeric_limits<double>::max();
-      for (int j = 0; j < c; j++)
+      for (qint64 leaf = firstLeaf; leaf < lastLeaf; leaf++)
       {
-        currentDistance = d(data_[i], centroids_[j]);
-        if (currentDistance < minDistance)
-          minDistance = currentDistance;
+        double total = 0.0;
+        const qint32 end = qMin<qint64>(size_, (leaf + 1) * leafSize);
+        for (qint32 i = qint32(leaf * leafSize); i < end; i++)
+        {
+          double current = d(point(i), newest);
+          if (current < dist[i])
+            dist[i] = current;
+          total += share(i);
+        }
+        totals[leaf] = total;
       }
-      distances[i] = minDistance;
-      totalDistance += minDistance;
-    }
-    // Transform distances to a PDF
-    std::transform(distances.begin(), distances.end(), distances.begin(),
-                  [&totalDistance](double& dist){return dist / totalDistance;});
-
-    // Create CDF from PDF
-    cdf[0] = distances[0];
-    for (int i = 1; i < cdf.size(); i++)
-      cdf[i] = cdf[i - 1] + distances[i];
-
-    // Pick point weighted on largest distance
-    pick = rand();
-    for (int i = 0; i < cdf.size(); i++)
+    });
+
+    // Same pairwise tree as the step
+    tree = leafTotals;
+    for (int width = 1; width < leaves; width *= 2)
+      for (int l = 0; l + width < leaves; l += 2 * width)
+        tree[l] += tree[l + width];
+
+    // Pick point weighted on its share, walking leaves then points. The
+    // last point with a nonzero share catches rounding at the end.
+    double pick = draw(RandomData::KppStream, c) * tree[0];
+    qint32 picked = -1;
+    for (int leaf = 0; leaf < leaves && picked < 0; leaf++)
     {
-      if (pick < cdf[i])
+      if (pick >= leafTotals[leaf] && leaf + 1 < leaves)
+      {
+        pick -= leafTotals[leaf];
+        continue;
+      }
+      const qint32 end = qMin(size_, (leaf + 1) * leafSize);
+      for (qint32 i = leaf * leafSize; i < end; i++)
       {
-        centroids_[c] = data_[i];
-        break;
+        const double s = share(i);
+        if (s > 0.0 && pick < s)
+        {
+          picked = i;
+          break;
+        }
+        pick -= s;
       }
     }
+    if (picked < 0)
+    {
+      for (qint32 i = size_ - 1; i >= 0 && picked < 0; i--)
+        if (share(i) > 0.0)
+          picked = i;
+    }
+    // Every point sits on a centroid already
+    if (picked < 0)
+      picked = qMin(qint32(draw(RandomData::KppStream, c) * size_), size_ - 1);
+    centroids_[c] = point(picked);
   }
   return true;
 }
 
+// Clusters the reduced data with this engine's settings and starts from its
+// centroids. Random initialization hands over its centroids.
+template<class T>
+bool kmeans<T>::initializeReduced(std::function<double(T, T)> d)
+{
+  TRACE_SCOPE("reduced", "kmeans");
+  kmeans<T> reduced(k_, reduced_, maxIterations_);
+  reduced.setInitialization(initType_);
+  reduced.setSeed(seed_);
+  reduced.setThreads(threads_);
+  reduced.setFullUpdateInterval(fullUpdateInterval_);
+  if (initType_ == InitializeType::Random)
+  {
+    if (!randomCentroidsInitialized_)
+      return false;
+    reduced.setRandomCentroids(centroids_);
+  }
+  reduced.finish(d);
+  if (reduced.iteration() == 0)
+    return false;
+  centroids_ = reduced.centroids();
+
+  if (statsEnabled_)
+  {
+    stats_.reducedPoints = reduced_->size();
+    stats_.reducedEnergy = reduced.getEnergy();
+    stats_.reductionBound = reductionBound(d);
+  }
+  return true;
+}
+
+// Weighted sum of the distances from the points to their representatives,
+// negative without them
+template<class T>
+double kmeans<T>::reductionBound(const std::function<double(T, T)>& d) const
+{
+  if (representative_.size() != size_)
+    return -1.0;
+  const quint32* representative = representative_.constData();
+  const double* const* reducedColumns = reduced_->columnData();
+  const double* weights = weights_;
+  return parallelReduce(size_, leafSize(), 0.0, [&](qint64 begin, qint64 end)
+  {
+    double sum = 0.0;
+    for (qint64 i = begin; i < end; i++)
+    {
+      const double shift = d(point(qint32(i)),
+                             T::FromColumns(reducedColumns,
+                                            qint32(representative[i])));
+      sum += weights ? weights[i] * shift : shift;
+    }
+    return sum;
+  }, [](double a, double b) { return a + b; });
+}
+
 #endif
 
 
@@ -2,37 +2,110 @@
 #define KMEANS_H
 
 #include <QVector>
-#include <QRandomGenerator>
+#include <algorithm>
 #include <functional>
-#include <random>
+#include <limits>
 #include <QString>
+#include <QElapsedTimer>
+#include "Trace.h"
+#include "Dataset.h"
+#include "Parallel.h"
+#include "Philox.h"
+#include "RandomData.h"
 
 enum InitializeType {Random, Sample, Kpp};
 
+// Counters for one call to step(). Only filled in when stats are enabled.
+struct KMeansStats
+{
+  quint32 iteration = 0;
+  qint64 initNs = 0;
+  qint64 assignNs = 0;
+  qint64 updateNs = 0;
+  quint64 distanceEvaluations = 0;
+  quint64 distancesSkipped = 0;
+  quint32 pointsReassigned = 0;
+  quint32 emptyClusters = 0;
+  double maxCentroidShift = 0.0;
+  int threadsUsed = 1;
+  // Only for the step that clustered a reduced data set (setReduction()):
+  // its points and energy, and the error bound, negative when unknown
+  qint32 reducedPoints = 0;
+  double reducedEnergy = 0.0;
+  double reductionBound = -1.0;
+};
+
+struct AssignmentChange
+{
+  quint32 point;
+  quint32 from;
+  quint32 to;
+};
+
+// What changed in one call to step(). When full is set the previous
+// assignments were not meaningful (first step after a reset or new data) and
+// changes is left empty, so consumers have to rescan assignments().
+struct KMeansDelta
+{
+  quint32 iteration = 0;
+  bool full = true;
+  QVector<AssignmentChange> changes;
+  QVector<quint32> movedCentroids;
+};
+
+// Lloyd's algorithm over a shared Dataset. Points are read from the data
+// set's columns as T::FromColumns(), the engine keeps no copy of them.
+//
+// Runs are reproducible: initialization draws from the engine's own seed, and
+// points are split into leaves that depend only on the number of points. Each
+// leaf is summed on one thread and the leaves are combined in a fixed pairwise
+// tree, so the same seed, data and settings give bit-identical centroids,
+// assignments and energy for any number of threads.
+//
+// Weighted data sets (Dataset::weights()) count each point weight times in
+// the centroid means, the energy and k-means++ sampling. The assign pass is
+// instantiated with and without weights, so unweighted data pays nothing.
+//
+// With a reduction (setReduction()) the first step clusters a small weighted
+// stand-in for the data to convergence and then assigns the full data once.
 template <class T>
 class kmeans
 {
 public:
   kmeans(int k, quint32 maxIterations = 1000);
-  kmeans(int k, QVector<T> data, quint32 maxIterations = 1000);
+  kmeans(int k, DatasetPtr data, quint32 maxIterations = 1000);
 
-  void setData(QVector<T> data);
+  void setData(DatasetPtr data);
   void setK(int k);
   void setInitialization(InitializeType type);
+  void setSeed(quint64 seed);
+  void setThreads(int threads);
+  void setReduction(DatasetPtr reduced,
+                    QVector<quint32> representative = QVector<quint32>(),
+                    bool refine = false);
   double getEnergy() { return energy_; };
   void setRandomCentroids(QVector<T> centroids);
   void setIgnoreSameAssignments(bool flag);
+  void setFullUpdateInterval(int iterations);
+  void setStatsEnabled(bool flag);
+  void setStatsCallback(std::function<void(const KMeansStats&)> callback);
+  const KMeansStats& lastStats() const { return stats_; };
+  const KMeansDelta& lastDelta() const { return delta_; };
 
   bool step(std::function<double(T, T)> d);
   bool step(std::function<double(T, T)> d, int steps);
   bool finish(std::function<double(T, T)> d);
   void reset();
+  void restoreState(quint32 iteration, QVector<T> centroids,
+                    QVector<quint32> assignments, double energy);
 
   QString stopReason;
 
   int k() const;
+  quint32 iteration() const;
   QVector<T>& centroids();
   QVector<quint32>& assignments();
+  QVector<quint32> rowAssignments() const;
 
   ~kmeans();
 
@@ -40,19 +113,80 @@ private:
   InitializeType initType_;
   double energy_;
   bool initialized_, randomCentroidsInitialized_, ignoreSame_;
+  bool statsEnabled_, sumsValid_, assignmentsValid_;
+  int fullUpdateInterval_;
   int maxIterations_;
   int currIteration_;
   int k_;
-  QVector<T> data_;
+  DatasetPtr data_;
+  const double* const* columns_;
+  const double* weights_;
+  qint32 size_;
+  quint64 seed_;
+  int threads_;
+  DatasetPtr reduced_;
+  QVector<quint32> representative_;
+  bool refine_;
   QVector<T> centroids_;
   QVector<quint32> assignments_;
+  QVector<T> sums_;
+  QVector<quint32> counts_;
+  // Weight per cluster, only kept for weighted data
+  QVector<double> weightSums_;
+
+  // Per leaf partial results of the assign phase, leaf 0 holds the totals
+  // after reduceLeaves()
+  QVector<T> leafSums_;
+  QVector<qint32> leafCounts_;
+  QVector<double> leafWeights_;
+  QVector<double> leafEnergy_;
+  QVector<quint32> leafReassigned_;
+  QVector<QVector<AssignmentChange>> leafChanges_;
+
+  KMeansStats stats_;
+  KMeansDelta delta_;
+  std::function<void(const KMeansStats&)> statsCallback_;
+
+  // Leaves hold at least MinLeafSize points and there are at most MaxLeaves
+  static const qint32 MinLeafSize = 4096;
+  static const qint32 MaxLeaves = 256;
 
-  QRandomGenerator* rand_;
+  // Raw pointers for one assign pass, taken before it goes parallel so no
+  // thread detaches a shared QVector
+  struct LeafPass
+  {
+    const T* centroids;
+    int k;
+    qint32 leafSize;
+    bool fullUpdate;
+    bool recordChanges;
+    quint32* assignments;
+    T* sums;
+    qint32* counts;
+    double* weights;
+    double* energy;
+    quint32* reassigned;
+    QVector<AssignmentChange>* changes;
+  };
 
+  T point(qint32 i) const { return T::FromColumns(columns_, i); };
+  qint32 leafSize() const;
+  int leafCount() const;
+  template <class F>
+  int forLeaves(int leaves, F f);
+  template <bool Weighted>
+  void assignLeaf(const LeafPass& pass, qint64 leaf,
+                  const std::function<double(T, T)>& d) const;
+  void reduceLeaves(int leaves);
+  double draw(quint32 stream, quint64 index) const;
   bool initialize(std::function<double(T, T)> d);
   bool checkRandomCentroids();
+  QVector<double> cumulativeWeights() const;
+  qint32 pickPoint(double u, const QVector<double>& cumulative) const;
   bool initializeSample();
   bool initializeKpp(std::function<double(T, T)> d);
+  bool initializeReduced(std::function<double(T, T)> d);
+  double reductionBound(const std::function<double(T, T)>& d) const;
 };
 
 #include "kmeans.cpp"
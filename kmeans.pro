@@ -9,9 +9,26 @@ CONFIG += c++11
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    ClusterCommand.cpp \
+    ClusterPlot2D.cpp \
+    ClusterScatter.cpp \
+    DecisionRegions.cpp \
+    DensityRaster.cpp \
+    GridAggregate.cpp \
     Controls3D.cpp \
+    Coreset.cpp \
+    Dataset.cpp \
+    Deduplicate.cpp \
     Info.cpp \
+    KMeansHistory.cpp \
+    KMeansRunner.cpp \
+    NumaBenchmark.cpp \
+    PointOctree.cpp \
+    PointRenderer.cpp \
     RandomData.cpp \
+    RenderBenchmark.cpp \
+    ThreadPool.cpp \
+    Trace.cpp \
     ViewWidget.cpp \
     kmeans.cpp \
     main.cpp \
@@ -19,10 +36,32 @@ SOURCES += \
     qcustomplot.cpp
 
 HEADERS += \
+    Benchmark.h \
+    ClusterCommand.h \
+    ClusterPlot2D.h \
+    ClusterScatter.h \
+    DecisionRegions.h \
+    DensityRaster.h \
+    GridAggregate.h \
     Controls3D.h \
+    Coreset.h \
+    Dataset.h \
+    Deduplicate.h \
     Info.h \
+    KMeansHistory.h \
+    KMeansRunner.h \
     MainWindow.h \
+    NumaBenchmark.h \
+    Pair.h \
+    Parallel.h \
+    Philox.h \
+    PointOctree.h \
+    PointRenderer.h \
     RandomData.h \
+    RenderBenchmark.h \
+    ThreadPool.h \
+    Trace.h \
+    TripleBuffer.h \
     ViewWidget.h \
     kmeans.h \
     qcustomplot.h
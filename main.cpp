@@ -1,10 +1,110 @@
+#include "ClusterCommand.h"
 #include "MainWindow.h"
+#include "NumaBenchmark.h"
+#include "RenderBenchmark.h"
+#include "ThreadPool.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
   QApplication a(argc, argv);
+
+  // Headless runs: QT_QPA_PLATFORM=offscreen ./kmeans --bench-render,
+  // --bench-numa or --cluster file
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  QCommandLineOption benchRender("bench-render",
+    "Benchmark the 3D view offscreen and write CSV rows.");
+  QCommandLineOption benchNuma("bench-numa",
+    "Benchmark k-means steps with and without NUMA placement.");
+  QCommandLineOption clusterFile("cluster",
+    "Cluster a data file and write the cluster of every point.", "file");
+  QCommandLineOption seed("seed", "Seed for --cluster.", "seed");
+  QCommandLineOption coreset("coreset",
+    "Cluster a coreset of this many points first.", "points");
+  QCommandLineOption dedup("dedup",
+    "Collapse points with the same coordinates before --cluster.");
+  QCommandLineOption grid("grid", "Cluster grid cells first.");
+  QCommandLineOption refine("refine",
+    "Continue on all points after --coreset or --grid.");
+  QCommandLineOption sizes("sizes", "Comma separated point counts.", "n,...");
+  QCommandLineOption clusters("k", "Number of clusters.", "k");
+  QCommandLineOption repeats("repeats", "Repeats per phase.", "count");
+  QCommandLineOption output("output", "Output file instead of stdout.",
+                            "file");
+  QCommandLineOption threads("threads",
+    "Threads in the shared pool, 0 for one per core. Comma separated counts "
+    "for --bench-numa.", "count");
+  QCommandLineOption pinThreads("pin-threads",
+    "Pin pool threads to cores.");
+  QCommandLineOption numa("numa",
+    "Spread pool threads over memory nodes and place data sets on them.");
+  parser.addOptions({benchRender, benchNuma, clusterFile, seed, dedup, coreset,
+                     grid, refine, sizes, clusters, repeats, output, threads,
+                     pinThreads, numa});
+  parser.process(a);
+
+  if (parser.isSet(benchNuma))
+  {
+    NumaBenchmark::Options options;
+    if (parser.isSet(sizes))
+    {
+      options.sizes.clear();
+      for (const QString& size : parser.value(sizes).split(','))
+        options.sizes.push_back(size.toLongLong());
+    }
+    if (parser.isSet(threads))
+      for (const QString& count : parser.value(threads).split(','))
+        options.threads.push_back(qMax(1, count.toInt()));
+    if (parser.isSet(clusters))
+      options.k = qMax(1, parser.value(clusters).toInt());
+    if (parser.isSet(repeats))
+      options.repeats = qMax(1, parser.value(repeats).toInt());
+    options.pinThreads = parser.isSet(pinThreads);
+    options.output = parser.value(output);
+    return NumaBenchmark::run(options);
+  }
+
+  // Before anything starts the pool
+  ThreadPool::configure(parser.value(threads).toInt(),
+                        parser.isSet(pinThreads), parser.isSet(numa));
+
+  if (parser.isSet(clusterFile))
+  {
+    ClusterCommand::Options options;
+    options.input = parser.value(clusterFile);
+    if (parser.isSet(clusters))
+      options.k = qMax(1, parser.value(clusters).toInt());
+    if (parser.isSet(seed))
+      options.seed = parser.value(seed).toULongLong();
+    if (parser.isSet(coreset))
+      options.coresetSize = qMax(1, parser.value(coreset).toInt());
+    options.dedup = parser.isSet(dedup);
+    options.grid = parser.isSet(grid);
+    options.refine = parser.isSet(refine);
+    options.output = parser.value(output);
+    return ClusterCommand::run(options);
+  }
+
+  if (parser.isSet(benchRender))
+  {
+    RenderBenchmark::Options options;
+    if (parser.isSet(sizes))
+    {
+      options.sizes.clear();
+      for (const QString& size : parser.value(sizes).split(','))
+        options.sizes.push_back(size.toLongLong());
+    }
+    if (parser.isSet(clusters))
+      options.k = qMax(1, parser.value(clusters).toInt());
+    if (parser.isSet(repeats))
+      options.repeats = qMax(1, parser.value(repeats).toInt());
+    options.output = parser.value(output);
+    return RenderBenchmark::run(options);
+  }
+
   MainWindow w;
   w.show();
   return a.exec();